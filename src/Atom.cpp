@@ -0,0 +1,70 @@
+/*
+ * Noumenon: A dynamic, strongly typed script language.
+ * Copyright (C) 2015 Tim Wiederhake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#include "Atom.h"
+
+#include <mutex>
+#include <unordered_set>
+
+using namespace std;
+
+namespace noumenon {
+
+/* the names of all atoms; elements of an unordered set never move. Scripts are parsed on several threads, see ModuleRegistry */
+static const u32string* intern(const u32string& name) {
+    static mutex lock;
+    static unordered_set<u32string> names;
+
+    lock_guard<mutex> guard(lock);
+    return &*names.insert(name).first;
+}
+
+Atom::Atom() : name(intern(U"")) {
+}
+
+Atom::Atom(const u32string& name) : name(intern(name)) {
+}
+
+Atom::Atom(const char32_t* name) : name(intern(name)) {
+}
+
+const u32string& Atom::str() const {
+    return *name;
+}
+
+Atom::operator const u32string&() const {
+    return *name;
+}
+
+bool Atom::empty() const {
+    return name->empty();
+}
+
+bool Atom::operator==(const Atom& other) const {
+    return name == other.name;
+}
+
+bool Atom::operator!=(const Atom& other) const {
+    return name != other.name;
+}
+
+bool Atom::operator<(const Atom& other) const {
+    return name != other.name && *name < *other.name;
+}
+
+} /* namespace noumenon */
@@ -0,0 +1,68 @@
+/*
+ * Noumenon: A dynamic, strongly typed script language.
+ * Copyright (C) 2015 Tim Wiederhake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef ATOM_H_
+#define ATOM_H_
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+namespace noumenon {
+
+/*
+ * An interned name, as used for identifiers and the keys of object literals.
+ * Every distinct name is stored once in a table that lives as long as the
+ * process, so atoms are tested for equality and hashed by address. They are
+ * still ordered by their characters, so maps of atoms keep the order of names.
+ */
+class Atom {
+public:
+    /* the empty name */
+    Atom();
+    Atom(const std::u32string&);
+    Atom(const char32_t*);
+
+    const std::u32string& str() const;
+    operator const std::u32string&() const;
+    bool empty() const;
+
+    bool operator==(const Atom&) const;
+    bool operator!=(const Atom&) const;
+    bool operator<(const Atom&) const;
+
+private:
+    friend struct std::hash<Atom>;
+
+    const std::u32string* name;
+};
+
+} /* namespace noumenon */
+
+namespace std {
+
+template<>
+struct hash<noumenon::Atom> {
+    size_t operator()(const noumenon::Atom& atom) const {
+        return hash<const u32string*>()(atom.name);
+    }
+};
+
+} /* namespace std */
+
+#endif /* ATOM_H_ */
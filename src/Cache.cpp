@@ -0,0 +1,643 @@
+/*
+ * Noumenon: A dynamic, strongly typed script language.
+ * Copyright (C) 2015 Tim Wiederhake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#include "Cache.h"
+#include "Value.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include <elf.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <link.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace noumenon {
+
+/* changes with the format of cache files; the build below covers changes of the parser */
+static const char version[] = "noumenon cache 2";
+
+/* node types as written to a cache file */
+enum class Node : unsigned char {
+    NONE,
+    ASSIGNMENT_STATEMENT,
+    CALL_STATEMENT,
+    EMPTY_STATEMENT,
+    FOR_STATEMENT,
+    IF_STATEMENT,
+    RETURN_STATEMENT,
+    VAR_STATEMENT,
+    WHILE_STATEMENT,
+    ARRAY_EXPRESSION,
+    BINARY_EXPRESSION,
+    BOOL_EXPRESSION,
+    CALL_EXPRESSION,
+    FLOAT_EXPRESSION,
+    FUNCTION_EXPRESSION,
+    INT_EXPRESSION,
+    NULL_EXPRESSION,
+    OBJECT_EXPRESSION,
+    STRING_EXPRESSION,
+    UNARY_EXPRESSION,
+    VARIABLE_EXPRESSION
+};
+
+static uint64_t hashBytes(const char* text, const size_t& size) {
+    uint64_t result = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i) {
+        result = (result ^ (unsigned char) text[i]) * 1099511628211ULL;
+    }
+    return result;
+}
+
+class Serializer : public StatementWalker, public ExpressionWalker {
+public:
+    Serializer(string& data) : data(data) {
+    }
+
+    void write(Statement* node) {
+        if (node == nullptr) {
+            tag(Node::NONE);
+        } else if (dynamic_cast<EmptyStatement*>(node) != nullptr) {
+            /* empty statements are never walked */
+            tag(Node::EMPTY_STATEMENT);
+        } else {
+            node->walk(*this);
+        }
+    }
+
+    void write(Expression* node) {
+        if (node == nullptr) {
+            tag(Node::NONE);
+        } else {
+            node->walk(*this);
+        }
+    }
+
+    Datum statement(AssignmentStatement& node) {
+        tag(Node::ASSIGNMENT_STATEMENT);
+        write(node.variable.get());
+        write(node.expression.get());
+        flag(node.append != nullptr);
+        return nullptr;
+    }
+
+    Datum statement(CallStatement& node) {
+        tag(Node::CALL_STATEMENT);
+        write(node.function.get());
+        write(node.expressions);
+        return nullptr;
+    }
+
+    Datum statement(ForStatement& node) {
+        tag(Node::FOR_STATEMENT);
+        write(node.key.str());
+        write(node.value.str());
+        write(node.expression.get());
+        write(node.statements);
+        return nullptr;
+    }
+
+    Datum statement(IfStatement& node) {
+        tag(Node::IF_STATEMENT);
+        write(node.condition.get());
+        write(node.statementsThen);
+        write(node.statementsElse);
+        return nullptr;
+    }
+
+    Datum statement(ReturnStatement& node) {
+        tag(Node::RETURN_STATEMENT);
+        write(node.expression.get());
+        flag(node.tailCall != nullptr);
+        return nullptr;
+    }
+
+    Datum statement(VarStatement& node) {
+        tag(Node::VAR_STATEMENT);
+        write(node.identifier.str());
+        write(node.expression.get());
+        return nullptr;
+    }
+
+    Datum statement(WhileStatement& node) {
+        tag(Node::WHILE_STATEMENT);
+        write(node.condition.get());
+        write(node.statements);
+        return nullptr;
+    }
+
+    Datum expression(ArrayExpression& node) {
+        tag(Node::ARRAY_EXPRESSION);
+        write(node.expressions);
+        return nullptr;
+    }
+
+    Datum expression(BinaryExpression& node) {
+        tag(Node::BINARY_EXPRESSION);
+        number((uint64_t) node.oper);
+        write(node.lhs.get());
+        write(node.rhs.get());
+        return nullptr;
+    }
+
+    Datum expression(BoolExpression& node) {
+        tag(Node::BOOL_EXPRESSION);
+        flag(node.value);
+        return nullptr;
+    }
+
+    Datum expression(CallExpression& node) {
+        tag(Node::CALL_EXPRESSION);
+        write(node.function.get());
+        write(node.expressions);
+        return nullptr;
+    }
+
+    Datum expression(FloatExpression& node) {
+        tag(Node::FLOAT_EXPRESSION);
+        uint64_t bits;
+        memcpy(&bits, &node.value, sizeof(bits));
+        number(bits);
+        return nullptr;
+    }
+
+    Datum expression(FunctionExpression& node) {
+        tag(Node::FUNCTION_EXPRESSION);
+        number(node.parameters.size());
+        for (const auto& parameter : node.parameters) {
+            write(parameter.str());
+        }
+        write(node.statements);
+        return nullptr;
+    }
+
+    Datum expression(IntExpression& node) {
+        tag(Node::INT_EXPRESSION);
+        number((uint64_t) node.value);
+        return nullptr;
+    }
+
+    Datum expression(NullExpression&) {
+        tag(Node::NULL_EXPRESSION);
+        return nullptr;
+    }
+
+    Datum expression(ObjectExpression& node) {
+        tag(Node::OBJECT_EXPRESSION);
+        number(node.values.size());
+        for (const auto& value : node.values) {
+            write(value.first.str());
+            write(value.second.get());
+        }
+        return nullptr;
+    }
+
+    Datum expression(StringExpression& node) {
+        tag(Node::STRING_EXPRESSION);
+        write(node.value);
+        return nullptr;
+    }
+
+    Datum expression(UnaryExpression& node) {
+        tag(Node::UNARY_EXPRESSION);
+        number((uint64_t) node.oper);
+        write(node.rhs.get());
+        return nullptr;
+    }
+
+    Datum expression(VariableExpression& node) {
+        tag(Node::VARIABLE_EXPRESSION);
+        write(node.identifier.str());
+        write(node.expressions);
+        return nullptr;
+    }
+
+private:
+    void tag(const Node& node) {
+        data += (char) node;
+    }
+
+    void flag(const bool& value) {
+        data += (char) value;
+    }
+
+    void number(const uint64_t& value) {
+        data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void write(const u32string& value) {
+        number(value.size());
+        data.append(reinterpret_cast<const char*>(value.data()), value.size() * sizeof(char32_t));
+    }
+
+    template<typename Node>
+    void write(const vector<shared_ptr<Node>>& nodes) {
+        number(nodes.size());
+        for (const auto& node : nodes) {
+            write(node.get());
+        }
+    }
+
+    string& data;
+};
+
+/* reads what the Serializer wrote, throws a string if the data is malformed */
+class Deserializer {
+public:
+    Deserializer(const char* begin, const char* end) : position(begin), end(end) {
+    }
+
+    bool atEnd() const {
+        return position == end;
+    }
+
+    shared_ptr<Statement> statement() {
+        switch (tag()) {
+        case Node::NONE:
+            return nullptr;
+        case Node::ASSIGNMENT_STATEMENT: {
+            auto node = make_shared<AssignmentStatement>();
+            node->variable = variable();
+            node->expression = expression();
+            if (flag()) {
+                node->append = dynamic_pointer_cast<BinaryExpression>(node->expression);
+            }
+            return node;
+        }
+        case Node::CALL_STATEMENT: {
+            auto node = make_shared<CallStatement>();
+            node->function = variable();
+            expressions(node->expressions);
+            return node;
+        }
+        case Node::EMPTY_STATEMENT:
+            return make_shared<EmptyStatement>();
+        case Node::FOR_STATEMENT: {
+            auto node = make_shared<ForStatement>();
+            node->key = string32();
+            node->value = string32();
+            node->expression = expression();
+            statements(node->statements);
+            return node;
+        }
+        case Node::IF_STATEMENT: {
+            auto node = make_shared<IfStatement>();
+            node->condition = expression();
+            statements(node->statementsThen);
+            statements(node->statementsElse);
+            return node;
+        }
+        case Node::RETURN_STATEMENT: {
+            auto node = make_shared<ReturnStatement>();
+            node->expression = expression();
+            if (flag()) {
+                node->tailCall = dynamic_pointer_cast<CallExpression>(node->expression);
+            }
+            return node;
+        }
+        case Node::VAR_STATEMENT: {
+            auto node = make_shared<VarStatement>();
+            node->identifier = string32();
+            node->expression = expression();
+            return node;
+        }
+        case Node::WHILE_STATEMENT: {
+            auto node = make_shared<WhileStatement>();
+            node->condition = expression();
+            statements(node->statements);
+            return node;
+        }
+        default:
+            throw string("malformed statement");
+        }
+    }
+
+    shared_ptr<Expression> expression() {
+        switch (tag()) {
+        case Node::NONE:
+            return nullptr;
+        case Node::ARRAY_EXPRESSION: {
+            auto node = make_shared<ArrayExpression>();
+            expressions(node->expressions);
+            return node;
+        }
+        case Node::BINARY_EXPRESSION: {
+            auto node = make_shared<BinaryExpression>();
+            node->oper = (BinaryOperator) number();
+            node->lhs = expression();
+            node->rhs = expression();
+            return node;
+        }
+        case Node::BOOL_EXPRESSION: {
+            auto node = make_shared<BoolExpression>();
+            node->value = flag();
+            return node;
+        }
+        case Node::CALL_EXPRESSION: {
+            auto node = make_shared<CallExpression>();
+            node->function = variable();
+            expressions(node->expressions);
+            return node;
+        }
+        case Node::FLOAT_EXPRESSION: {
+            auto node = make_shared<FloatExpression>();
+            const auto bits = number();
+            memcpy(&node->value, &bits, sizeof(bits));
+            return node;
+        }
+        case Node::FUNCTION_EXPRESSION: {
+            auto node = make_shared<FunctionExpression>();
+            for (auto count = number(); count > 0; --count) {
+                node->parameters.push_back(string32());
+            }
+            statements(node->statements);
+            return node;
+        }
+        case Node::INT_EXPRESSION: {
+            auto node = make_shared<IntExpression>();
+            node->value = (signed long long) number();
+            return node;
+        }
+        case Node::NULL_EXPRESSION:
+            return make_shared<NullExpression>();
+        case Node::OBJECT_EXPRESSION: {
+            auto node = make_shared<ObjectExpression>();
+            for (auto count = number(); count > 0; --count) {
+                const Atom key = string32();
+                node->values[key] = expression();
+            }
+            return node;
+        }
+        case Node::STRING_EXPRESSION: {
+            auto node = make_shared<StringExpression>();
+            node->value = string32();
+            return node;
+        }
+        case Node::UNARY_EXPRESSION: {
+            auto node = make_shared<UnaryExpression>();
+            node->oper = (UnaryOperator) number();
+            node->rhs = expression();
+            return node;
+        }
+        case Node::VARIABLE_EXPRESSION: {
+            auto node = make_shared<VariableExpression>();
+            node->identifier = string32();
+            expressions(node->expressions);
+            return node;
+        }
+        default:
+            throw string("malformed expression");
+        }
+    }
+
+private:
+    void need(const size_t& count) {
+        if ((size_t) (end - position) < count) {
+            throw string("truncated cache");
+        }
+    }
+
+    Node tag() {
+        need(1);
+        return (Node) *position++;
+    }
+
+    bool flag() {
+        need(1);
+        return *position++ != 0;
+    }
+
+    uint64_t number() {
+        uint64_t result;
+        need(sizeof(result));
+        memcpy(&result, position, sizeof(result));
+        position += sizeof(result);
+        return result;
+    }
+
+    u32string string32() {
+        const auto size = number();
+        if (size > (uint64_t) (end - position) / sizeof(char32_t)) {
+            throw string("truncated cache");
+        }
+        u32string result(size, 0);
+        memcpy(&result[0], position, size * sizeof(char32_t));
+        position += size * sizeof(char32_t);
+        return result;
+    }
+
+    shared_ptr<VariableExpression> variable() {
+        auto result = dynamic_pointer_cast<VariableExpression>(expression());
+        if (!result) {
+            throw string("malformed variable");
+        }
+        return result;
+    }
+
+    void expressions(vector<shared_ptr<Expression>>& result) {
+        for (auto count = number(); count > 0; --count) {
+            result.push_back(expression());
+        }
+    }
+
+    void statements(vector<shared_ptr<Statement>>& result) {
+        for (auto count = number(); count > 0; --count) {
+            result.push_back(statement());
+        }
+    }
+
+    const char* position;
+    const char* end;
+};
+
+Cache::Writer::Writer() : data(), complete(false) {
+}
+
+void Cache::Writer::finish() {
+    complete = true;
+}
+
+void Cache::Writer::add(Statement& statement) {
+    Serializer serializer(data);
+    serializer.write(&statement);
+}
+
+bool Cache::Writer::isComplete() const {
+    return complete;
+}
+
+vector<shared_ptr<Statement>> Cache::Writer::read() const {
+    vector<shared_ptr<Statement>> result;
+    Deserializer deserializer(data.data(), data.data() + data.size());
+    while (!deserializer.atEnd()) {
+        result.push_back(deserializer.statement());
+    }
+    return result;
+}
+
+Cache::Cache(const string& directory) : directory(directory) {
+}
+
+string Cache::fileOf(const string& path) const {
+    char buffer[PATH_MAX];
+    const string canonical = realpath(path.c_str(), buffer) != nullptr ? buffer : path;
+
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.nmc", (unsigned long long) hashBytes(canonical.data(), canonical.size()));
+    return directory + "/" + name;
+}
+
+/* the GNU build ID of the interpreter's executable, the hash of the whole file if it has none */
+static const string& build() {
+    static const string identity = [] {
+        string result;
+        dl_iterate_phdr([](dl_phdr_info* info, size_t, void* data) {
+            auto& result = *static_cast<string*>(data);
+            for (unsigned i = 0; i < info->dlpi_phnum && result.empty(); ++i) {
+                const auto& header = info->dlpi_phdr[i];
+                if (header.p_type != PT_NOTE) {
+                    continue;
+                }
+
+                /* notes are aligned to four bytes */
+                auto note = reinterpret_cast<const char*>(info->dlpi_addr + header.p_vaddr);
+                const auto end = note + header.p_memsz;
+                while (note + sizeof(ElfW(Nhdr)) <= end) {
+                    const auto& entry = *reinterpret_cast<const ElfW(Nhdr)*>(note);
+                    const auto name = note + sizeof(ElfW(Nhdr));
+                    const auto description = name + ((entry.n_namesz + 3) & ~3u);
+                    if (entry.n_type == NT_GNU_BUILD_ID && entry.n_namesz == 4 && memcmp(name, "GNU", 4) == 0) {
+                        result.assign(description, entry.n_descsz);
+                        break;
+                    }
+                    note = description + ((entry.n_descsz + 3) & ~3u);
+                }
+            }
+
+            /* the executable comes first */
+            return 1;
+        }, &result);
+
+        if (result.empty()) {
+            ifstream executable("/proc/self/exe", ios::binary);
+            const string contents((istreambuf_iterator<char>(executable)), istreambuf_iterator<char>());
+            const auto hash = hashBytes(contents.data(), contents.size());
+            result.assign(reinterpret_cast<const char*>(&hash), sizeof(hash));
+        }
+        return result;
+    }();
+    return identity;
+}
+
+string Cache::header(const string& path, const char* text, const size_t& size) {
+    struct stat status;
+    if (stat(path.c_str(), &status) != 0) {
+        return "";
+    }
+
+    const uint64_t fields[] = {
+        (uint64_t) status.st_mtim.tv_sec,
+        (uint64_t) status.st_mtim.tv_nsec,
+        (uint64_t) size,
+        hashBytes(text, size)
+    };
+
+    const auto& identity = build();
+    const uint32_t length = identity.size();
+
+    string result(version, sizeof(version));
+    result.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    result.append(identity);
+    result.append(reinterpret_cast<const char*>(fields), sizeof(fields));
+    return result;
+}
+
+bool Cache::load(const string& path, const char* text, const size_t& size, vector<shared_ptr<Statement>>& statements) const {
+    const auto expected = header(path, text, size);
+    if (expected.empty()) {
+        return false;
+    }
+
+    const auto descriptor = open(fileOf(path).c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        return false;
+    }
+
+    struct stat status;
+    void* memory = MAP_FAILED;
+    if (fstat(descriptor, &status) == 0 && (size_t) status.st_size >= expected.size()) {
+        memory = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    }
+    close(descriptor);
+    if (memory == MAP_FAILED) {
+        return false;
+    }
+
+    const auto begin = static_cast<const char*>(memory);
+    bool valid = memcmp(begin, expected.data(), expected.size()) == 0;
+    if (valid) {
+        try {
+            Deserializer deserializer(begin + expected.size(), begin + status.st_size);
+            while (!deserializer.atEnd()) {
+                statements.push_back(deserializer.statement());
+            }
+        } catch (const string&) {
+            statements.clear();
+            valid = false;
+        }
+    }
+
+    munmap(memory, status.st_size);
+    return valid;
+}
+
+void Cache::store(const string& path, const char* text, const size_t& size, const Writer& writer) const {
+    const auto contents = writer.complete ? header(path, text, size) : "";
+    if (contents.empty()) {
+        return;
+    }
+
+    /* written to a temporary file first, so that no other process ever reads half a cache */
+    const auto file = fileOf(path);
+    const auto temporary = file + "." + to_string(getpid());
+    {
+        ofstream output(temporary, ios::binary | ios::trunc);
+        output.write(contents.data(), contents.size());
+        output.write(writer.data.data(), writer.data.size());
+        if (!output) {
+            output.close();
+            unlink(temporary.c_str());
+            return;
+        }
+    }
+
+    if (rename(temporary.c_str(), file.c_str()) != 0) {
+        unlink(temporary.c_str());
+    }
+}
+
+} /* namespace noumenon */
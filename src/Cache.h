@@ -0,0 +1,80 @@
+/*
+ * Noumenon: A dynamic, strongly typed script language.
+ * Copyright (C) 2015 Tim Wiederhake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef CACHE_H_
+#define CACHE_H_
+
+#include "Statement.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace noumenon {
+
+/*
+ * Parsed scripts stored on disk, so that a script that did not change since
+ * its last run is neither lexed nor parsed again. A cache file holds the
+ * syntax trees of all top level statements as the parser produced them, i.e.
+ * before the Resolver and the Optimizer ran. It is only used if it was written
+ * by the same build of the interpreter for a source file of the same
+ * modification time, size and content hash; anything else is a miss and the
+ * file is written anew once the script was parsed completely.
+ */
+class Cache {
+public:
+    /* caches are files in the given directory, named after the path of their source */
+    explicit Cache(const std::string& directory);
+
+    /* the statements of a script; returns false if there is no valid cache */
+    bool load(const std::string& path, const char* text, const std::size_t& size, std::vector<std::shared_ptr<Statement>>&) const;
+
+    /* statements serialized one by one while the script is parsed */
+    class Writer {
+    public:
+        Writer();
+
+        void add(Statement&);
+
+        /* all statements were added, i.e. the whole script parsed */
+        void finish();
+        bool isComplete() const;
+
+        /* new syntax trees of the statements added */
+        std::vector<std::shared_ptr<Statement>> read() const;
+
+    private:
+        friend class Cache;
+        std::string data;
+        bool complete;
+    };
+
+    /* only complete writers are stored; errors are ignored, a cache that could not be written is a miss the next time */
+    void store(const std::string& path, const char* text, const std::size_t& size, const Writer&) const;
+
+private:
+    std::string fileOf(const std::string& path) const;
+    static std::string header(const std::string& path, const char* text, const std::size_t& size);
+
+    std::string directory;
+};
+
+} /* namespace noumenon */
+
+#endif /* CACHE_H_ */
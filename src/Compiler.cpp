@@ -0,0 +1,422 @@
+/*
+ * Noumenon: A dynamic, strongly typed script language.
+ * Copyright (C) 2015 Tim Wiederhake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#include "Compiler.h"
+#include "Value.h"
+
+using namespace std;
+
+namespace noumenon {
+
+static Opcode binary_opcode(const BinaryOperator& oper) {
+    switch (oper) {
+    case BinaryOperator::ADD:
+        return Opcode::ADD;
+    case BinaryOperator::SUB:
+        return Opcode::SUB;
+    case BinaryOperator::MUL:
+        return Opcode::MUL;
+    case BinaryOperator::DIV:
+        return Opcode::DIV;
+    case BinaryOperator::MOD:
+        return Opcode::MOD;
+    case BinaryOperator::AND:
+        return Opcode::AND;
+    case BinaryOperator::OR:
+        return Opcode::OR;
+    case BinaryOperator::EQU:
+        return Opcode::EQU;
+    case BinaryOperator::NEQ:
+        return Opcode::NEQ;
+    case BinaryOperator::LES:
+        return Opcode::LES;
+    case BinaryOperator::LEQ:
+        return Opcode::LEQ;
+    case BinaryOperator::GRT:
+        return Opcode::GRT;
+    case BinaryOperator::GEQ:
+        return Opcode::GEQ;
+    }
+
+    return Opcode::ADD;
+}
+
+shared_ptr<Chunk> Compiler::compile(const vector<Atom>& parameters, const vector<shared_ptr<Statement>>& statements, shared_ptr<Layout> layout) {
+    auto chunk = make_shared<Chunk>();
+    chunk->registers = 0;
+    chunk->parameters = parameters;
+    chunk->statements = statements;
+    chunk->layout = layout;
+    chunk->hotness = 0;
+
+    Compiler compiler(*chunk);
+    compiler.compile(statements);
+    compiler.emit(Opcode::END);
+    return chunk;
+}
+
+shared_ptr<Chunk> Compiler::compile(Statement& statement) {
+    auto chunk = make_shared<Chunk>();
+    chunk->registers = 0;
+    chunk->hotness = 0;
+
+    Compiler compiler(*chunk);
+    statement.walk(compiler);
+    compiler.emit(Opcode::END);
+    return chunk;
+}
+
+Compiler::Compiler(Chunk& chunk) : chunk(chunk), top(0), target(0) {
+}
+
+unsigned Compiler::allocate() {
+    top += 1;
+    if (top > chunk.registers) {
+        chunk.registers = top;
+    }
+    return top - 1;
+}
+
+void Compiler::release(const unsigned& reg) {
+    top = reg;
+}
+
+unsigned Compiler::emit(const Opcode& op, const unsigned& a, const unsigned& b, const unsigned& c) {
+    chunk.code.push_back({op, a, b, c});
+    return chunk.code.size() - 1;
+}
+
+void Compiler::patch(const unsigned& jump) {
+    chunk.code[jump].b = chunk.code.size();
+}
+
+unsigned Compiler::constant(const Datum& value) {
+    chunk.constants.push_back(value);
+    return chunk.constants.size() - 1;
+}
+
+unsigned Compiler::variable(const Atom& identifier, const Address& address) {
+    for (decltype(chunk.variables.size()) i = 0; i < chunk.variables.size(); ++i) {
+        const auto& other = chunk.variables[i];
+        if (other.address.depth == address.depth && other.address.slot == address.slot && other.address.resolved == address.resolved && other.identifier == identifier) {
+            return i;
+        }
+    }
+
+    chunk.variables.push_back({identifier, address});
+    return chunk.variables.size() - 1;
+}
+
+unsigned Compiler::layout(shared_ptr<Layout> layout) {
+    chunk.layouts.push_back(layout);
+    return chunk.layouts.size() - 1;
+}
+
+unsigned Compiler::cache(shared_ptr<InlineCache> cache) {
+    chunk.caches.push_back(cache);
+    return chunk.caches.size() - 1;
+}
+
+unsigned Compiler::shape(const Shape* shape) {
+    chunk.shapes.push_back(shape);
+    return chunk.shapes.size() - 1;
+}
+
+void Compiler::compile(Expression& expression, const unsigned& reg) {
+    const auto saved = target;
+    target = reg;
+    expression.walk(*this);
+    target = saved;
+}
+
+void Compiler::compile(const vector<shared_ptr<Statement>>& statements) {
+    for (auto& statement : statements) {
+        statement->walk(*this);
+    }
+}
+
+void Compiler::block(const vector<shared_ptr<Statement>>& statements, shared_ptr<Layout> layout) {
+    if (!layout) {
+        compile(statements);
+        return;
+    }
+
+    emit(Opcode::ENTER, 0, this->layout(layout));
+    compile(statements);
+    emit(Opcode::LEAVE);
+}
+
+void Compiler::call(VariableExpression& function, const vector<shared_ptr<Expression>>& expressions, const unsigned& reg, const Opcode& op) {
+    /* arguments are evaluated before the function itself */
+    const auto base = allocate();
+    for (auto& expression : expressions) {
+        compile(*expression, allocate());
+    }
+    compile(function, base);
+
+    emit(op, reg, base, expressions.size());
+    release(base);
+}
+
+void Compiler::select(VariableExpression& variable, const unsigned& position, const unsigned& object, const unsigned& index) {
+    if (position < variable.caches.size() && variable.caches[position]) {
+        emit(Opcode::SELECTKEY, object, object, cache(variable.caches[position]));
+        return;
+    }
+
+    compile(*variable.expressions[position], index);
+    emit(Opcode::SELECT, object, object, index);
+}
+
+Datum Compiler::statement(AssignmentStatement& node) {
+    if (node.append) {
+        /* the addition and the write only run if the array cannot grow in place */
+        const auto value = allocate();
+        compile(*node.append->lhs, value);
+        const auto rhs = allocate();
+        compile(*node.append->rhs, rhs);
+
+        const auto target = variable(node.variable->identifier, node.variable->address);
+        emit(Opcode::APPEND, value, target, rhs);
+        emit(Opcode::ADD, value, value, rhs);
+        emit(Opcode::WRITE, value, target);
+        release(value);
+        return nullptr;
+    }
+
+    const auto value = allocate();
+    compile(*node.expression, value);
+
+    if (node.variable->expressions.empty()) {
+        emit(Opcode::WRITE, value, variable(node.variable->identifier, node.variable->address));
+        release(value);
+        return nullptr;
+    }
+
+    const auto object = allocate();
+    const auto index = allocate();
+    emit(Opcode::READ, object, variable(node.variable->identifier, node.variable->address));
+
+    const unsigned last = node.variable->expressions.size() - 1;
+    for (unsigned i = 0; i < last; ++i) {
+        select(*node.variable, i, object, index);
+    }
+
+    if (last < node.variable->caches.size() && node.variable->caches[last]) {
+        emit(Opcode::MODIFYKEY, object, cache(node.variable->caches[last]), value);
+    } else {
+        compile(*node.variable->expressions.back(), index);
+        emit(Opcode::MODIFY, object, index, value);
+    }
+
+    release(value);
+    return nullptr;
+}
+
+Datum Compiler::statement(CallStatement& node) {
+    const auto result = allocate();
+    call(*node.function, node.expressions, result);
+    release(result);
+    return nullptr;
+}
+
+Datum Compiler::statement(ForStatement& node) {
+    /* iterated value, counter, key, value and whether the value is a range */
+    const auto base = allocate();
+    allocate();
+    allocate();
+    allocate();
+    allocate();
+
+    compile(*node.expression, base);
+    emit(Opcode::FORPREP, base);
+
+    /* all iterations share one scope */
+    const auto scope = layout(node.layout);
+    emit(Opcode::ENTER, 0, scope);
+    const auto loop = emit(Opcode::FORNEXT, base, 0, !node.key.empty());
+    emit(Opcode::RENEW, 0, scope);
+    if (!node.key.empty()) {
+        emit(Opcode::DEFINE, base + 2, variable(node.key, node.keyAddress));
+    }
+    emit(Opcode::DEFINE, base + 3, variable(node.value, node.valueAddress));
+    compile(node.statements);
+    emit(Opcode::JUMP, 0, loop);
+    patch(loop);
+    emit(Opcode::LEAVE);
+
+    release(base);
+    return nullptr;
+}
+
+Datum Compiler::statement(IfStatement& node) {
+    const auto condition = allocate();
+    compile(*node.condition, condition);
+    release(condition);
+
+    const auto jumpElse = emit(Opcode::JUMPIFNOT, condition);
+    block(node.statementsThen, node.layoutThen);
+
+    if (node.statementsElse.empty()) {
+        patch(jumpElse);
+        return nullptr;
+    }
+
+    const auto jumpEnd = emit(Opcode::JUMP);
+    patch(jumpElse);
+    block(node.statementsElse, node.layoutElse);
+    patch(jumpEnd);
+    return nullptr;
+}
+
+Datum Compiler::statement(ReturnStatement& node) {
+    if (node.tailCall) {
+        call(*node.tailCall->function, node.tailCall->expressions, 0, Opcode::TAILCALL);
+        return nullptr;
+    }
+
+    const auto value = allocate();
+    compile(*node.expression, value);
+    emit(Opcode::RETURN, value);
+    release(value);
+    return nullptr;
+}
+
+Datum Compiler::statement(VarStatement& node) {
+    const auto value = allocate();
+    compile(*node.expression, value);
+    emit(Opcode::DEFINE, value, variable(node.identifier, node.address));
+    release(value);
+    return nullptr;
+}
+
+Datum Compiler::statement(WhileStatement& node) {
+    const auto loop = chunk.code.size();
+    const auto condition = allocate();
+    compile(*node.condition, condition);
+    release(condition);
+
+    const auto jumpEnd = emit(Opcode::JUMPIFNOT, condition);
+    block(node.statements, node.layout);
+    emit(Opcode::JUMP, 0, loop);
+    patch(jumpEnd);
+    return nullptr;
+}
+
+Datum Compiler::expression(ArrayExpression& node) {
+    const auto reg = target;
+    const auto base = top;
+    for (auto& expression : node.expressions) {
+        compile(*expression, allocate());
+    }
+
+    emit(Opcode::ARRAY, reg, base, node.expressions.size());
+    release(base);
+    return nullptr;
+}
+
+Datum Compiler::expression(BinaryExpression& node) {
+    const auto reg = target;
+    compile(*node.lhs, reg);
+
+    const auto rhs = allocate();
+    compile(*node.rhs, rhs);
+    emit(binary_opcode(node.oper), reg, reg, rhs);
+    release(rhs);
+    return nullptr;
+}
+
+Datum Compiler::expression(BoolExpression& node) {
+    emit(Opcode::LOADCONST, target, constant(Datum(node.value)));
+    return nullptr;
+}
+
+Datum Compiler::expression(CallExpression& node) {
+    call(*node.function, node.expressions, target);
+    return nullptr;
+}
+
+Datum Compiler::expression(FloatExpression& node) {
+    emit(Opcode::LOADCONST, target, constant(Datum(node.value)));
+    return nullptr;
+}
+
+Datum Compiler::expression(FunctionExpression& node) {
+    chunk.functions.push_back(compile(node.parameters, node.statements, node.layout));
+    emit(Opcode::FUNCTION, target, chunk.functions.size() - 1);
+    return nullptr;
+}
+
+Datum Compiler::expression(IntExpression& node) {
+    emit(Opcode::LOADCONST, target, constant(Datum(node.value)));
+    return nullptr;
+}
+
+Datum Compiler::expression(NullExpression&) {
+    emit(Opcode::LOADNULL, target);
+    return nullptr;
+}
+
+Datum Compiler::expression(ObjectExpression& node) {
+    if (node.shape == nullptr) {
+        vector<u32string> keys;
+        for (auto& pair : node.values) {
+            keys.push_back(pair.first);
+        }
+        node.shape = Shape::of(keys);
+    }
+
+    const auto reg = target;
+    const auto base = top;
+    for (auto& pair : node.values) {
+        compile(*pair.second, allocate());
+    }
+
+    emit(Opcode::OBJECT, reg, shape(node.shape), base);
+    release(base);
+    return nullptr;
+}
+
+Datum Compiler::expression(StringExpression& node) {
+    if (!node.constant) {
+        node.constant = make_shared<StringValue>(node.value);
+    }
+    emit(Opcode::LOADCONST, target, constant(node.constant));
+    return nullptr;
+}
+
+Datum Compiler::expression(UnaryExpression& node) {
+    const auto reg = target;
+    compile(*node.rhs, reg);
+    emit(node.oper == UnaryOperator::NEG ? Opcode::NEG : Opcode::NOT, reg, reg);
+    return nullptr;
+}
+
+Datum Compiler::expression(VariableExpression& node) {
+    const auto reg = target;
+    emit(Opcode::READ, reg, variable(node.identifier, node.address));
+
+    const auto index = allocate();
+    for (unsigned i = 0; i < node.expressions.size(); ++i) {
+        select(node, i, reg, index);
+    }
+    release(index);
+    return nullptr;
+}
+
+} /* namespace noumenon */
@@ -0,0 +1,167 @@
+/*
+ * Noumenon: A dynamic, strongly typed script language.
+ * Copyright (C) 2015 Tim Wiederhake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef COMPILER_H_
+#define COMPILER_H_
+
+#include "Expression.h"
+#include "Statement.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace noumenon {
+
+class NativeCode;
+
+enum class Opcode : unsigned char {
+    LOADNULL,   /* R[a] = null */
+    LOADCONST,  /* R[a] = K[b] */
+    FUNCTION,   /* R[a] = function with body F[b] */
+    ARRAY,      /* R[a] = [R[b], ..., R[b + c - 1]] */
+    OBJECT,     /* R[a] = object of shape S[b] with the values R[c], ... */
+
+    READ,       /* R[a] = variable V[b] */
+    WRITE,      /* variable V[b] = R[a] */
+    DEFINE,     /* var V[b] = R[a] */
+    APPEND,     /* if V[b] is R[a], an array nothing else refers to: append R[c] in place and skip two instructions */
+    SELECT,     /* R[a] = R[b][R[c]] */
+    SELECTKEY,  /* R[a] = R[b][key of C[c]] */
+    MODIFY,     /* R[a][R[b]] = R[c] */
+    MODIFYKEY,  /* R[a][key of C[b]] = R[c] */
+
+    ADD,        /* R[a] = R[b] + R[c] */
+    SUB,        /* R[a] = R[b] - R[c] */
+    MUL,        /* R[a] = R[b] * R[c] */
+    DIV,        /* R[a] = R[b] / R[c] */
+    MOD,        /* R[a] = R[b] % R[c] */
+    AND,        /* R[a] = R[b] && R[c] */
+    OR,         /* R[a] = R[b] || R[c] */
+    EQU,        /* R[a] = R[b] == R[c] */
+    NEQ,        /* R[a] = R[b] != R[c] */
+    LES,        /* R[a] = R[b] < R[c] */
+    LEQ,        /* R[a] = R[b] <= R[c] */
+    GRT,        /* R[a] = R[b] > R[c] */
+    GEQ,        /* R[a] = R[b] >= R[c] */
+    NEG,        /* R[a] = -R[b] */
+    NOT,        /* R[a] = !R[b] */
+
+    CALL,       /* R[a] = R[b](R[b + 1], ..., R[b + c]) */
+    TAILCALL,   /* return R[b](R[b + 1], ..., R[b + c]), reusing the scope if R[b] is the running function */
+    JUMP,       /* goto b */
+    JUMPIFNOT,  /* if (!R[a]) goto b */
+    ENTER,      /* open a nested scope with layout L[b] */
+    RENEW,      /* start the innermost scope over with layout L[b], i.e. clear its variables */
+    LEAVE,      /* close the innermost scope */
+    FORPREP,    /* R[a + 1] = 0, R[a + 4] = whether R[a] is a range, see RangeValue */
+    FORNEXT,    /* step over R[a] with counter R[a + 1], key to R[a + 2] if c, value to R[a + 3]; goto b when done */
+    RETURN,     /* return R[a] */
+    END         /* return without value */
+};
+
+struct Variable {
+    Atom identifier;
+    Address address;
+};
+
+struct Instruction {
+    Opcode op;
+    unsigned a;
+    unsigned b;
+    unsigned c;
+};
+
+/* compiled body of a function or a top level statement */
+struct Chunk {
+    std::vector<Instruction> code;
+    std::vector<Datum> constants;
+    std::vector<Variable> variables;
+    std::vector<std::shared_ptr<Layout>> layouts;
+    std::vector<std::shared_ptr<Chunk>> functions;
+    std::vector<std::shared_ptr<InlineCache>> caches;
+    std::vector<const Shape*> shapes;
+    unsigned registers;
+
+    /* source of the chunk, needed to create function values */
+    std::vector<Atom> parameters;
+    std::vector<std::shared_ptr<Statement>> statements;
+    std::shared_ptr<Layout> layout;
+
+    /* calls and loop iterations so far, the chunk is compiled to native code when it gets hot */
+    unsigned hotness;
+    std::shared_ptr<NativeCode> native;
+};
+
+class Compiler : public StatementWalker, public ExpressionWalker {
+public:
+    static std::shared_ptr<Chunk> compile(const std::vector<Atom>&, const std::vector<std::shared_ptr<Statement>>&, std::shared_ptr<Layout>);
+
+    /* compile a single statement to run in the current scope, e.g. a loop that got hot in the tree walker */
+    static std::shared_ptr<Chunk> compile(Statement&);
+
+    Datum statement(AssignmentStatement&);
+    Datum statement(CallStatement&);
+    Datum statement(ForStatement&);
+    Datum statement(IfStatement&);
+    Datum statement(ReturnStatement&);
+    Datum statement(VarStatement&);
+    Datum statement(WhileStatement&);
+
+    Datum expression(ArrayExpression&);
+    Datum expression(BinaryExpression&);
+    Datum expression(BoolExpression&);
+    Datum expression(CallExpression&);
+    Datum expression(FloatExpression&);
+    Datum expression(FunctionExpression&);
+    Datum expression(IntExpression&);
+    Datum expression(NullExpression&);
+    Datum expression(ObjectExpression&);
+    Datum expression(StringExpression&);
+    Datum expression(UnaryExpression&);
+    Datum expression(VariableExpression&);
+
+private:
+    explicit Compiler(Chunk&);
+
+    /* registers are allocated like a stack */
+    unsigned allocate();
+    void release(const unsigned&);
+
+    unsigned emit(const Opcode&, const unsigned& a = 0, const unsigned& b = 0, const unsigned& c = 0);
+    void patch(const unsigned&);
+    unsigned constant(const Datum&);
+    unsigned variable(const Atom&, const Address&);
+    unsigned layout(std::shared_ptr<Layout>);
+    unsigned cache(std::shared_ptr<InlineCache>);
+    unsigned shape(const Shape*);
+
+    void compile(Expression&, const unsigned&);
+    void compile(const std::vector<std::shared_ptr<Statement>>&);
+    void block(const std::vector<std::shared_ptr<Statement>>&, std::shared_ptr<Layout>);
+    void call(VariableExpression&, const std::vector<std::shared_ptr<Expression>>&, const unsigned&, const Opcode& = Opcode::CALL);
+    void select(VariableExpression&, const unsigned&, const unsigned&, const unsigned&);
+
+    Chunk& chunk;
+    unsigned top;
+    unsigned target;
+};
+
+} /* namespace noumenon */
+
+#endif /* COMPILER_H_ */
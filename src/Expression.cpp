@@ -17,57 +17,58 @@
  */
 
 #include "Expression.h"
+#include "Value.h"
 
 namespace noumenon {
 
 Expression::~Expression() {
 }
 
-std::shared_ptr<Value> VariableExpression::walk(ExpressionWalker& walker) {
+Datum VariableExpression::walk(ExpressionWalker& walker) {
     return walker.expression(*this);
 }
 
-std::shared_ptr<Value> ArrayExpression::walk(ExpressionWalker& walker) {
+Datum ArrayExpression::walk(ExpressionWalker& walker) {
     return walker.expression(*this);
 }
 
-std::shared_ptr<Value> BinaryExpression::walk(ExpressionWalker& walker) {
+Datum BinaryExpression::walk(ExpressionWalker& walker) {
     return walker.expression(*this);
 }
 
-std::shared_ptr<Value> BoolExpression::walk(ExpressionWalker& walker) {
+Datum BoolExpression::walk(ExpressionWalker& walker) {
     return walker.expression(*this);
 }
 
-std::shared_ptr<Value> CallExpression::walk(ExpressionWalker& walker) {
+Datum CallExpression::walk(ExpressionWalker& walker) {
     return walker.expression(*this);
 }
 
-std::shared_ptr<Value> FloatExpression::walk(ExpressionWalker& walker) {
+Datum FloatExpression::walk(ExpressionWalker& walker) {
     return walker.expression(*this);
 }
 
-std::shared_ptr<Value> FunctionExpression::walk(ExpressionWalker& walker) {
+Datum FunctionExpression::walk(ExpressionWalker& walker) {
     return walker.expression(*this);
 }
 
-std::shared_ptr<Value> IntExpression::walk(ExpressionWalker& walker) {
+Datum IntExpression::walk(ExpressionWalker& walker) {
     return walker.expression(*this);
 }
 
-std::shared_ptr<Value> NullExpression::walk(ExpressionWalker& walker) {
+Datum NullExpression::walk(ExpressionWalker& walker) {
     return walker.expression(*this);
 }
 
-std::shared_ptr<Value> ObjectExpression::walk(ExpressionWalker& walker) {
+Datum ObjectExpression::walk(ExpressionWalker& walker) {
     return walker.expression(*this);
 }
 
-std::shared_ptr<Value> StringExpression::walk(ExpressionWalker& walker) {
+Datum StringExpression::walk(ExpressionWalker& walker) {
     return walker.expression(*this);
 }
 
-std::shared_ptr<Value> UnaryExpression::walk(ExpressionWalker& walker) {
+Datum UnaryExpression::walk(ExpressionWalker& walker) {
     return walker.expression(*this);
 }
 
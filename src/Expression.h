@@ -19,6 +19,8 @@
 #ifndef EXPRESSION_H_
 #define EXPRESSION_H_
 
+#include "Atom.h"
+
 #include <map>
 #include <memory>
 #include <string>
@@ -28,7 +30,12 @@ namespace noumenon {
 
 class ExpressionWalker;
 
+struct InlineCache;
+struct Layout;
 struct Statement;
+class Datum;
+class Shape;
+struct StringValue;
 struct Value;
 
 enum class BinaryOperator {
@@ -52,103 +59,144 @@ enum class UnaryOperator {
     NOT
 };
 
+/*
+ * Operand types an operator expression has been specialized to. A node is
+ * specialized on its first evaluation and falls back to the generic operation
+ * for good as soon as it sees operands of another type.
+ */
+enum class Specialization : unsigned char {
+    NONE,       /* not evaluated yet */
+    BOOL,
+    INT,
+    FLOAT,
+    GENERIC
+};
+
+/* location of a variable, filled in by the Resolver */
+struct Address {
+    /* number of scopes to go up */
+    unsigned depth;
+
+    /* slot in that scope, if resolved */
+    unsigned slot;
+
+    /* if not resolved, the variable is looked up by name */
+    bool resolved;
+
+    /* see Layout::maskOf */
+    unsigned long long mask;
+};
+
 struct Expression {
     virtual ~Expression() = 0;
-    virtual std::shared_ptr<Value> walk(ExpressionWalker&) = 0;
+    virtual Datum walk(ExpressionWalker&) = 0;
 };
 
 struct VariableExpression : public Expression {
-    std::u32string identifier;
+    Atom identifier;
     std::vector<std::shared_ptr<Expression>> expressions;
+    Address address;
 
-    std::shared_ptr<Value> walk(ExpressionWalker&);
+    /* per selector, filled in by the Resolver where the selector is a string literal */
+    std::vector<std::shared_ptr<InlineCache>> caches;
+
+    Datum walk(ExpressionWalker&);
 };
 
 struct ArrayExpression : public Expression {
     std::vector<std::shared_ptr<Expression>> expressions;
 
-    std::shared_ptr<Value> walk(ExpressionWalker&);
+    Datum walk(ExpressionWalker&);
 };
 
 struct BinaryExpression : public Expression {
     BinaryOperator oper;
     std::shared_ptr<Expression> lhs;
     std::shared_ptr<Expression> rhs;
+    Specialization specialization;
 
-    std::shared_ptr<Value> walk(ExpressionWalker&);
+    Datum walk(ExpressionWalker&);
 };
 
 struct BoolExpression : public Expression {
     bool value;
 
-    std::shared_ptr<Value> walk(ExpressionWalker&);
+    Datum walk(ExpressionWalker&);
 };
 
 struct CallExpression : public Expression {
     std::shared_ptr<VariableExpression> function;
     std::vector<std::shared_ptr<Expression>> expressions;
 
-    std::shared_ptr<Value> walk(ExpressionWalker&);
+    Datum walk(ExpressionWalker&);
 };
 
 struct FloatExpression : public Expression {
     double value;
 
-    std::shared_ptr<Value> walk(ExpressionWalker&);
+    Datum walk(ExpressionWalker&);
 };
 
 struct FunctionExpression : public Expression {
-    std::vector<std::u32string> parameters;
+    std::vector<Atom> parameters;
     std::vector<std::shared_ptr<Statement>> statements;
+    std::shared_ptr<Layout> layout;
 
-    std::shared_ptr<Value> walk(ExpressionWalker&);
+    Datum walk(ExpressionWalker&);
 };
 
 struct IntExpression : public Expression {
     signed long long value;
 
-    std::shared_ptr<Value> walk(ExpressionWalker&);
+    Datum walk(ExpressionWalker&);
 };
 
 struct NullExpression : public Expression {
-    std::shared_ptr<Value> walk(ExpressionWalker&);
+    Datum walk(ExpressionWalker&);
 };
 
 struct ObjectExpression : public Expression {
-    std::map<std::u32string, std::shared_ptr<Expression>> values;
+    std::map<Atom, std::shared_ptr<Expression>> values;
+
+    /* shape of the created objects, looked up on first evaluation */
+    const Shape* shape;
 
-    std::shared_ptr<Value> walk(ExpressionWalker&);
+    Datum walk(ExpressionWalker&);
 };
 
 struct StringExpression : public Expression {
     std::u32string value;
 
-    std::shared_ptr<Value> walk(ExpressionWalker&);
+    /* created on first evaluation and shared by all further ones */
+    std::shared_ptr<StringValue> constant;
+
+    Datum walk(ExpressionWalker&);
 };
 
 struct UnaryExpression : public Expression {
     UnaryOperator oper;
     std::shared_ptr<Expression> rhs;
+    Specialization specialization;
 
-    std::shared_ptr<Value> walk(ExpressionWalker&);
+    Datum walk(ExpressionWalker&);
 };
 
 class ExpressionWalker {
 public:
     virtual ~ExpressionWalker() = 0;
 
-    virtual std::shared_ptr<Value> expression(ArrayExpression&) = 0;
-    virtual std::shared_ptr<Value> expression(BinaryExpression&) = 0;
-    virtual std::shared_ptr<Value> expression(BoolExpression&) = 0;
-    virtual std::shared_ptr<Value> expression(CallExpression&) = 0;
-    virtual std::shared_ptr<Value> expression(FloatExpression&) = 0;
-    virtual std::shared_ptr<Value> expression(FunctionExpression&) = 0;
-    virtual std::shared_ptr<Value> expression(IntExpression&) = 0;
-    virtual std::shared_ptr<Value> expression(NullExpression&) = 0;
-    virtual std::shared_ptr<Value> expression(ObjectExpression&) = 0;
-    virtual std::shared_ptr<Value> expression(StringExpression&) = 0;
-    virtual std::shared_ptr<Value> expression(UnaryExpression&) = 0;
-    virtual std::shared_ptr<Value> expression(VariableExpression&) = 0;
+    virtual Datum expression(ArrayExpression&) = 0;
+    virtual Datum expression(BinaryExpression&) = 0;
+    virtual Datum expression(BoolExpression&) = 0;
+    virtual Datum expression(CallExpression&) = 0;
+    virtual Datum expression(FloatExpression&) = 0;
+    virtual Datum expression(FunctionExpression&) = 0;
+    virtual Datum expression(IntExpression&) = 0;
+    virtual Datum expression(NullExpression&) = 0;
+    virtual Datum expression(ObjectExpression&) = 0;
+    virtual Datum expression(StringExpression&) = 0;
+    virtual Datum expression(UnaryExpression&) = 0;
+    virtual Datum expression(VariableExpression&) = 0;
 };
 
 } /* namespace noumenon */
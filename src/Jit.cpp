@@ -0,0 +1,544 @@
+/*
+ * Noumenon: A dynamic, strongly typed script language.
+ * Copyright (C) 2015 Tim Wiederhake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#include "Jit.h"
+#include "Compiler.h"
+#include "Machine.h"
+#include "Value.h"
+
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define NOUMENON_JIT
+#endif
+
+using namespace std;
+
+namespace noumenon {
+
+NativeCode::NativeCode(void* memory, const size_t& size) : entry(reinterpret_cast<Entry>(memory)), memory(memory), size(size) {
+}
+
+NativeCode::~NativeCode() {
+#ifdef NOUMENON_JIT
+    munmap(memory, size);
+#endif
+}
+
+#ifdef NOUMENON_JIT
+
+namespace {
+
+enum class Condition : unsigned char {
+    AE = 0x3,
+    E = 0x4,
+    NE = 0x5,
+    A = 0x7,
+    S = 0x8,
+    P = 0xa,
+    NP = 0xb,
+    L = 0xc,
+    GE = 0xd,
+    LE = 0xe,
+    G = 0xf
+};
+
+/*
+ * Emits the handful of instructions the compiler needs. Memory operands are
+ * relative to rbx, which points to the registers of the Machine, unless noted
+ * otherwise; r12 holds the Machine itself.
+ */
+class Assembler {
+public:
+    Assembler() : code() {
+    }
+
+    size_t here() const {
+        return code.size();
+    }
+
+    void emit(initializer_list<unsigned char> bytes) {
+        code.insert(code.end(), bytes);
+    }
+
+    void emit(const vector<unsigned char>& bytes) {
+        code.insert(code.end(), bytes.begin(), bytes.end());
+    }
+
+    void imm32(const uint32_t& value) {
+        for (unsigned i = 0; i < 4; ++i) {
+            code.push_back((value >> (8 * i)) & 0xff);
+        }
+    }
+
+    void imm64(const uint64_t& value) {
+        for (unsigned i = 0; i < 8; ++i) {
+            code.push_back((value >> (8 * i)) & 0xff);
+        }
+    }
+
+    /* ModRM byte and displacement of [rbx + displacement] */
+    void memory(const unsigned char& reg, const int32_t& displacement) {
+        code.push_back(0x80 | reg << 3 | 3);
+        imm32(displacement);
+    }
+
+    /* ModRM byte and displacement of [rax + displacement] */
+    void memoryRax(const unsigned char& reg, const int8_t& displacement) {
+        code.push_back(0x40 | reg << 3);
+        code.push_back(displacement);
+    }
+
+    /* jumps return the position of their target, see bind */
+    size_t jump() {
+        emit({0xe9});
+        imm32(0);
+        return here() - 4;
+    }
+
+    size_t jump(const Condition& condition) {
+        emit({0x0f, (unsigned char) (0x80 | (unsigned char) condition)});
+        imm32(0);
+        return here() - 4;
+    }
+
+    void bind(const size_t& position, const size_t& target) {
+        const uint32_t offset = target - (position + 4);
+        memcpy(&code[position], &offset, 4);
+    }
+
+    void bind(const size_t& position) {
+        bind(position, here());
+    }
+
+    /* cmp byte [rbx + displacement], value */
+    void compareByte(const int32_t& displacement, const unsigned char& value) {
+        emit({0x80});
+        memory(7, displacement);
+        code.push_back(value);
+    }
+
+    /* mov byte [rbx + displacement], value */
+    void storeByte(const int32_t& displacement, const unsigned char& value) {
+        emit({0xc6});
+        memory(0, displacement);
+        code.push_back(value);
+    }
+
+    /* setcc al, mov [rbx + displacement], al */
+    void storeCondition(const Condition& condition, const int32_t& displacement) {
+        emit({0x0f, (unsigned char) (0x90 | (unsigned char) condition), 0xc0, 0x88});
+        memory(0, displacement);
+    }
+
+    /* call a helper with the Machine and the given argument, leaves its result in rax */
+    void call(const uint64_t& function, const void* argument) {
+        emit({0x4c, 0x89, 0xe7, 0x48, 0xbe});
+        imm64(reinterpret_cast<uint64_t>(argument));
+        emit({0x48, 0xb8});
+        imm64(function);
+        emit({0xff, 0xd0});
+    }
+
+    /* call the Machine to execute an instruction and test its result */
+    void execute(const Instruction& instruction) {
+        call(reinterpret_cast<uint64_t>(&Machine::execute), &instruction);
+        emit({0x85, 0xc0});
+    }
+
+    vector<unsigned char> code;
+};
+
+/* x86-64 opcodes of the inline fast paths */
+struct Arithmetic {
+    Opcode op;
+    vector<unsigned char> integer;
+    vector<unsigned char> real;
+};
+
+const Arithmetic arithmetic[] = {
+    {Opcode::ADD, {0x48, 0x03}, {0xf2, 0x0f, 0x58}},
+    {Opcode::SUB, {0x48, 0x2b}, {0xf2, 0x0f, 0x5c}},
+    {Opcode::MUL, {0x48, 0x0f, 0xaf}, {0xf2, 0x0f, 0x59}}
+};
+
+struct Comparison {
+    Opcode op;
+    Condition integer;
+
+    /* floating point numbers are compared with ucomisd, which sets the flags like an unsigned comparison */
+    Condition real;
+    bool swap;
+};
+
+const Comparison comparisons[] = {
+    {Opcode::EQU, Condition::E, Condition::E, false},
+    {Opcode::NEQ, Condition::NE, Condition::NE, false},
+    {Opcode::LES, Condition::L, Condition::A, true},
+    {Opcode::LEQ, Condition::LE, Condition::AE, true},
+    {Opcode::GRT, Condition::G, Condition::A, false},
+    {Opcode::GEQ, Condition::GE, Condition::AE, false}
+};
+
+/* copies a reference between a register and a slot */
+void assign(Datum* target, const Datum* source) {
+    *target = *source;
+}
+
+} /* anonymous namespace */
+
+shared_ptr<NativeCode> Jit::compile(const Chunk& chunk) {
+    const int32_t tagOffset = offsetof(Datum, tag);
+    const int32_t valueOffset = offsetof(Datum, integer);
+    const auto tag = [&](const unsigned& reg) {
+        return (int32_t) (reg * sizeof(Datum)) + tagOffset;
+    };
+    const auto value = [&](const unsigned& reg) {
+        return (int32_t) (reg * sizeof(Datum)) + valueOffset;
+    };
+
+    const auto INT = (unsigned char) Datum::Tag::INT;
+    const auto FLOAT = (unsigned char) Datum::Tag::FLOAT;
+    const auto BOOL = (unsigned char) Datum::Tag::BOOL;
+    const auto BOXED = (unsigned char) Datum::Tag::BOXED;
+
+    Assembler assembler;
+    vector<size_t> labels(chunk.code.size());
+    vector<pair<size_t, unsigned>> jumps;
+    vector<size_t> exits;
+
+    /* push rbx; push r12; sub rsp, 8; mov r12, rdi; mov rbx, rsi */
+    assembler.emit({0x53, 0x41, 0x54, 0x48, 0x83, 0xec, 0x08, 0x49, 0x89, 0xfc, 0x48, 0x89, 0xf3});
+
+    /* the Machine enters at the first instruction or at the head of a loop, i.e. at the target of a backward jump */
+    for (unsigned pc = 0; pc < chunk.code.size(); ++pc) {
+        const auto& i = chunk.code[pc];
+        if (i.op == Opcode::JUMP && i.b <= pc) {
+            /* cmp edx, b */
+            assembler.emit({0x81, 0xfa});
+            assembler.imm32(i.b);
+            jumps.emplace_back(assembler.jump(Condition::E), i.b);
+        }
+    }
+
+    for (unsigned pc = 0; pc < chunk.code.size(); ++pc) {
+        const auto& i = chunk.code[pc];
+        labels[pc] = assembler.here();
+
+        switch (i.op) {
+        case Opcode::JUMP:
+            jumps.emplace_back(assembler.jump(), i.b);
+            continue;
+
+        case Opcode::JUMPIFNOT: {
+            assembler.compareByte(tag(i.a), BOOL);
+            const auto generic = assembler.jump(Condition::NE);
+            assembler.compareByte(value(i.a), 0);
+            jumps.emplace_back(assembler.jump(Condition::E), i.b);
+            const auto next = assembler.jump();
+
+            assembler.bind(generic);
+            assembler.execute(i);
+            exits.push_back(assembler.jump(Condition::S));
+            jumps.emplace_back(assembler.jump(Condition::NE), i.b);
+            assembler.bind(next);
+            continue;
+        }
+
+        case Opcode::FORNEXT:
+            assembler.execute(i);
+            exits.push_back(assembler.jump(Condition::S));
+            jumps.emplace_back(assembler.jump(Condition::NE), i.b);
+            continue;
+
+        case Opcode::APPEND: {
+            /* only arrays can grow in place */
+            assembler.compareByte(tag(i.a), BOXED);
+            const auto next = assembler.jump(Condition::NE);
+            assembler.execute(i);
+            exits.push_back(assembler.jump(Condition::S));
+            jumps.emplace_back(assembler.jump(Condition::NE), pc + 3);
+            assembler.bind(next);
+            continue;
+        }
+
+        case Opcode::RETURN:
+        case Opcode::TAILCALL:
+            assembler.execute(i);
+            exits.push_back(assembler.jump());
+            continue;
+
+        case Opcode::END:
+            exits.push_back(assembler.jump());
+            continue;
+
+        case Opcode::LOADNULL: {
+            assembler.compareByte(tag(i.a), BOXED);
+            const auto generic = assembler.jump(Condition::E);
+            assembler.storeByte(tag(i.a), (unsigned char) Datum::Tag::NUL);
+            const auto next = assembler.jump();
+
+            assembler.bind(generic);
+            assembler.execute(i);
+            exits.push_back(assembler.jump(Condition::S));
+            assembler.bind(next);
+            continue;
+        }
+
+        case Opcode::LOADCONST: {
+            const auto& constant = chunk.constants[i.b];
+            if (constant.tag == Datum::Tag::BOXED) {
+                break;
+            }
+
+            uint64_t bits;
+            memcpy(&bits, reinterpret_cast<const unsigned char*>(&constant) + valueOffset, sizeof(bits));
+
+            assembler.compareByte(tag(i.a), BOXED);
+            const auto generic = assembler.jump(Condition::E);
+            /* mov rax, bits; mov [a], rax */
+            assembler.emit({0x48, 0xb8});
+            assembler.imm64(bits);
+            assembler.emit({0x48, 0x89});
+            assembler.memory(0, value(i.a));
+            assembler.storeByte(tag(i.a), (unsigned char) constant.tag);
+            const auto next = assembler.jump();
+
+            assembler.bind(generic);
+            assembler.execute(i);
+            exits.push_back(assembler.jump(Condition::S));
+            assembler.bind(next);
+            continue;
+        }
+
+        case Opcode::READ:
+        case Opcode::WRITE: {
+            if (!chunk.variables[i.b].address.resolved) {
+                break;
+            }
+
+            /* scalars are copied between a register and the slot of a resolved variable, anything else needs reference counting */
+            assembler.call(reinterpret_cast<uint64_t>(&Machine::locate), &chunk.variables[i.b]);
+            /* test rax, rax */
+            assembler.emit({0x48, 0x85, 0xc0});
+            const auto unresolved = assembler.jump(Condition::E);
+
+            size_t boxedSource, boxedTarget;
+            if (i.op == Opcode::READ) {
+                /* movzx ecx, byte [rax + tag]; cmp cl, BOXED */
+                assembler.emit({0x0f, 0xb6});
+                assembler.memoryRax(1, tagOffset);
+                assembler.emit({0x80, 0xf9, BOXED});
+                boxedSource = assembler.jump(Condition::E);
+                assembler.compareByte(tag(i.a), BOXED);
+                boxedTarget = assembler.jump(Condition::E);
+                /* mov rdx, [rax + value]; mov [a], rdx; mov [a], cl */
+                assembler.emit({0x48, 0x8b});
+                assembler.memoryRax(2, valueOffset);
+                assembler.emit({0x48, 0x89});
+                assembler.memory(2, value(i.a));
+                assembler.emit({0x88});
+                assembler.memory(1, tag(i.a));
+            } else {
+                /* cmp byte [rax + tag], BOXED */
+                assembler.emit({0x80});
+                assembler.memoryRax(7, tagOffset);
+                assembler.emit({BOXED});
+                boxedTarget = assembler.jump(Condition::E);
+                /* movzx ecx, byte [a]; cmp cl, BOXED */
+                assembler.emit({0x0f, 0xb6});
+                assembler.memory(1, tag(i.a));
+                assembler.emit({0x80, 0xf9, BOXED});
+                boxedSource = assembler.jump(Condition::E);
+                /* mov rdx, [a]; mov [rax + value], rdx; mov [rax + tag], cl */
+                assembler.emit({0x48, 0x8b});
+                assembler.memory(2, value(i.a));
+                assembler.emit({0x48, 0x89});
+                assembler.memoryRax(2, valueOffset);
+                assembler.emit({0x88});
+                assembler.memoryRax(1, tagOffset);
+            }
+            const auto copied = assembler.jump();
+
+            assembler.bind(boxedSource);
+            assembler.bind(boxedTarget);
+            if (i.op == Opcode::READ) {
+                /* lea rdi, [a]; mov rsi, rax */
+                assembler.emit({0x48, 0x8d});
+                assembler.memory(7, (int32_t) (i.a * sizeof(Datum)));
+                assembler.emit({0x48, 0x89, 0xc6});
+            } else {
+                /* mov rdi, rax; lea rsi, [a] */
+                assembler.emit({0x48, 0x89, 0xc7, 0x48, 0x8d});
+                assembler.memory(6, (int32_t) (i.a * sizeof(Datum)));
+            }
+            assembler.emit({0x48, 0xb8});
+            assembler.imm64(reinterpret_cast<uint64_t>(&assign));
+            assembler.emit({0xff, 0xd0});
+            const auto next = assembler.jump();
+
+            assembler.bind(unresolved);
+            assembler.execute(i);
+            exits.push_back(assembler.jump(Condition::S));
+            assembler.bind(next);
+            assembler.bind(copied);
+            continue;
+        }
+
+        default:
+            break;
+        }
+
+        const Arithmetic* operation = nullptr;
+        for (auto& candidate : arithmetic) {
+            if (candidate.op == i.op) {
+                operation = &candidate;
+            }
+        }
+
+        const Comparison* comparison = nullptr;
+        for (auto& candidate : comparisons) {
+            if (candidate.op == i.op) {
+                comparison = &candidate;
+            }
+        }
+
+        if (operation == nullptr && comparison == nullptr) {
+            assembler.execute(i);
+            exits.push_back(assembler.jump(Condition::S));
+            continue;
+        }
+
+        /* both operands are integers and the result does not overwrite a reference */
+        assembler.compareByte(tag(i.b), INT);
+        const auto notInt = assembler.jump(Condition::NE);
+        assembler.compareByte(tag(i.c), INT);
+        const auto genericInt = assembler.jump(Condition::NE);
+        assembler.compareByte(tag(i.a), BOXED);
+        const auto boxedInt = assembler.jump(Condition::E);
+
+        /* mov rax, [b] */
+        assembler.emit({0x48, 0x8b});
+        assembler.memory(0, value(i.b));
+        if (operation) {
+            assembler.emit(operation->integer);
+            assembler.memory(0, value(i.c));
+            /* mov [a], rax */
+            assembler.emit({0x48, 0x89});
+            assembler.memory(0, value(i.a));
+            assembler.storeByte(tag(i.a), INT);
+        } else {
+            /* cmp rax, [c] */
+            assembler.emit({0x48, 0x3b});
+            assembler.memory(0, value(i.c));
+            assembler.storeCondition(comparison->integer, value(i.a));
+            assembler.storeByte(tag(i.a), BOOL);
+        }
+        const auto nextInt = assembler.jump();
+
+        /* both operands are floating point numbers */
+        assembler.bind(notInt);
+        assembler.compareByte(tag(i.b), FLOAT);
+        const auto notFloat = assembler.jump(Condition::NE);
+        assembler.compareByte(tag(i.c), FLOAT);
+        const auto genericFloat = assembler.jump(Condition::NE);
+        assembler.compareByte(tag(i.a), BOXED);
+        const auto boxedFloat = assembler.jump(Condition::E);
+
+        const bool swap = comparison && comparison->swap;
+
+        /* movsd xmm0, [b] */
+        assembler.emit({0xf2, 0x0f, 0x10});
+        assembler.memory(0, value(swap ? i.c : i.b));
+        if (operation) {
+            assembler.emit(operation->real);
+            assembler.memory(0, value(i.c));
+            /* movsd [a], xmm0 */
+            assembler.emit({0xf2, 0x0f, 0x11});
+            assembler.memory(0, value(i.a));
+            assembler.storeByte(tag(i.a), FLOAT);
+        } else {
+            /* ucomisd xmm0, [c] */
+            assembler.emit({0x66, 0x0f, 0x2e});
+            assembler.memory(0, value(swap ? i.b : i.c));
+            if (i.op == Opcode::EQU) {
+                /* sete al; setnp cl; and al, cl */
+                assembler.emit({0x0f, 0x94, 0xc0, 0x0f, 0x9b, 0xc1, 0x20, 0xc8, 0x88});
+                assembler.memory(0, value(i.a));
+            } else if (i.op == Opcode::NEQ) {
+                /* setne al; setp cl; or al, cl */
+                assembler.emit({0x0f, 0x95, 0xc0, 0x0f, 0x9a, 0xc1, 0x08, 0xc8, 0x88});
+                assembler.memory(0, value(i.a));
+            } else {
+                assembler.storeCondition(comparison->real, value(i.a));
+            }
+            assembler.storeByte(tag(i.a), BOOL);
+        }
+        const auto nextFloat = assembler.jump();
+
+        for (const auto& generic : {genericInt, boxedInt, notFloat, genericFloat, boxedFloat}) {
+            assembler.bind(generic);
+        }
+        assembler.execute(i);
+        exits.push_back(assembler.jump(Condition::S));
+
+        assembler.bind(nextInt);
+        assembler.bind(nextFloat);
+    }
+
+    /* add rsp, 8; pop r12; pop rbx; ret */
+    const auto epilogue = assembler.here();
+    assembler.emit({0x48, 0x83, 0xc4, 0x08, 0x41, 0x5c, 0x5b, 0xc3});
+
+    for (const auto& jump : jumps) {
+        assembler.bind(jump.first, labels[jump.second]);
+    }
+    for (const auto& exit : exits) {
+        assembler.bind(exit, epilogue);
+    }
+
+    const size_t page = sysconf(_SC_PAGESIZE);
+    const size_t size = (assembler.code.size() + page - 1) / page * page;
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        return nullptr;
+    }
+
+    memcpy(memory, assembler.code.data(), assembler.code.size());
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, size);
+        return nullptr;
+    }
+
+    return make_shared<NativeCode>(memory, size);
+}
+
+#else
+
+shared_ptr<NativeCode> Jit::compile(const Chunk&) {
+    return nullptr;
+}
+
+#endif
+
+} /* namespace noumenon */
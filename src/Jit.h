@@ -0,0 +1,68 @@
+/*
+ * Noumenon: A dynamic, strongly typed script language.
+ * Copyright (C) 2015 Tim Wiederhake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef JIT_H_
+#define JIT_H_
+
+#include <cstddef>
+#include <memory>
+
+namespace noumenon {
+
+class Datum;
+class Machine;
+struct Chunk;
+
+/* machine code of a chunk, in memory of its own */
+class NativeCode {
+public:
+    /* runs the chunk from the given instruction, which is either the first one or the head of a loop */
+    typedef void (*Entry)(Machine*, Datum*, unsigned);
+
+    NativeCode(void*, const std::size_t&);
+    ~NativeCode();
+
+    NativeCode(const NativeCode&) = delete;
+    NativeCode& operator=(const NativeCode&) = delete;
+
+    const Entry entry;
+
+private:
+    void* const memory;
+    const std::size_t size;
+};
+
+/*
+ * Baseline compiler from bytecode to x86-64 machine code. Every instruction is
+ * translated on its own: jumps become native jumps, arithmetic and comparisons
+ * of integers and floating point numbers are done inline, and everything else
+ * calls Machine::execute. Registers and scopes stay where the Machine keeps
+ * them, so native code can take over from the Machine at the head of any loop.
+ */
+class Jit {
+public:
+    /* calls of a chunk plus iterations of its loops before it is compiled */
+    static const unsigned threshold = 100;
+
+    /* returns nullptr where native code is not supported */
+    static std::shared_ptr<NativeCode> compile(const Chunk&);
+};
+
+} /* namespace noumenon */
+
+#endif /* JIT_H_ */
@@ -0,0 +1,321 @@
+/*
+ * Noumenon: A dynamic, strongly typed script language.
+ * Copyright (C) 2015 Tim Wiederhake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#include "Machine.h"
+#include "Jit.h"
+#include "Program.h"
+#include "Value.h"
+
+using namespace std;
+
+namespace noumenon {
+
+Machine::Machine(Program& program, Chunk& chunk) : program(program), chunk(chunk), registers(chunk.registers), scopes(), scope(&program), jit(program.isJit()), branched(false), result(), error() {
+}
+
+Machine::~Machine() {
+    while (!scopes.empty()) {
+        scopes.pop_back();
+    }
+}
+
+Datum Machine::operator()() {
+    if (jit && !chunk.native && ++chunk.hotness == Jit::threshold) {
+        chunk.native = Jit::compile(chunk);
+    }
+
+    if (jit && chunk.native) {
+        return enter(0);
+    }
+
+    return run<false>(0);
+}
+
+int Machine::execute(Machine* machine, const Instruction* instruction) {
+    try {
+        auto returnValue = machine->run<true>(instruction - machine->chunk.code.data());
+        if (!returnValue.isEmpty()) {
+            machine->result = move(returnValue);
+            return 1;
+        }
+        return machine->branched ? 1 : 0;
+    } catch (...) {
+        machine->error = current_exception();
+        return -1;
+    }
+}
+
+Datum* Machine::locate(Machine* machine, const Variable* variable) {
+    return machine->scope->resolveVariable(variable->address);
+}
+
+Datum Machine::enter(const unsigned& pc) {
+    const auto native = chunk.native;
+    native->entry(this, registers.data(), pc);
+
+    if (error) {
+        rethrow_exception(error);
+    }
+
+    return move(result);
+}
+
+template<bool single>
+Datum Machine::run(const unsigned& entry) {
+    const Instruction* code = chunk.code.data();
+    Datum* reg = registers.data();
+
+    for (unsigned pc = entry;;) {
+        const Instruction& i = code[pc++];
+
+        switch (i.op) {
+        case Opcode::LOADNULL:
+            reg[i.a] = NullValue::singleton;
+            break;
+
+        case Opcode::LOADCONST:
+            reg[i.a] = chunk.constants[i.b];
+            break;
+
+        case Opcode::FUNCTION: {
+            const auto& body = chunk.functions[i.b];
+            auto function = make_shared<FunctionValue>(body->parameters, body->statements);
+            function->layout = body->layout;
+            function->chunk = body;
+            reg[i.a] = function;
+            break;
+        }
+
+        case Opcode::ARRAY:
+            reg[i.a] = make_shared<ArrayValue>(vector<Datum>(reg + i.b, reg + i.b + i.c));
+            break;
+
+        case Opcode::OBJECT: {
+            const auto& shape = chunk.shapes[i.b];
+            reg[i.a] = make_shared<ObjectValue>(shape, vector<Datum>(reg + i.c, reg + i.c + shape->getKeys().size()));
+            break;
+        }
+
+        case Opcode::READ: {
+            const auto& variable = chunk.variables[i.b];
+            reg[i.a] = scope->readVariable(variable.address, variable.identifier);
+            break;
+        }
+
+        case Opcode::WRITE: {
+            const auto& variable = chunk.variables[i.b];
+            scope->writeVariable(variable.address, variable.identifier, reg[i.a]);
+            break;
+        }
+
+        case Opcode::DEFINE: {
+            const auto& variable = chunk.variables[i.b];
+            scope->defineVariable(variable.address, variable.identifier, reg[i.a]);
+            break;
+        }
+
+        case Opcode::APPEND: {
+            const auto& variable = chunk.variables[i.b];
+            if (scope->appendVariable(variable.address, variable.identifier, reg[i.a], reg[i.c])) {
+                pc += 2;
+            }
+            break;
+        }
+
+        case Opcode::SELECT:
+            reg[i.a] = reg[i.b].doSelect(reg[i.c]);
+            break;
+
+        case Opcode::SELECTKEY:
+            reg[i.a] = reg[i.b].doSelect(*chunk.caches[i.c]);
+            break;
+
+        case Opcode::MODIFY:
+            reg[i.a].doModify(reg[i.b], reg[i.c]);
+            break;
+
+        case Opcode::MODIFYKEY:
+            reg[i.a].doModify(*chunk.caches[i.b], reg[i.c]);
+            break;
+
+        case Opcode::ADD:
+            reg[i.a] = reg[i.b].doBinary(BinaryOperator::ADD, reg[i.c]);
+            break;
+
+        case Opcode::SUB:
+            reg[i.a] = reg[i.b].doBinary(BinaryOperator::SUB, reg[i.c]);
+            break;
+
+        case Opcode::MUL:
+            reg[i.a] = reg[i.b].doBinary(BinaryOperator::MUL, reg[i.c]);
+            break;
+
+        case Opcode::DIV:
+            reg[i.a] = reg[i.b].doBinary(BinaryOperator::DIV, reg[i.c]);
+            break;
+
+        case Opcode::MOD:
+            reg[i.a] = reg[i.b].doBinary(BinaryOperator::MOD, reg[i.c]);
+            break;
+
+        case Opcode::AND:
+            reg[i.a] = reg[i.b].doBinary(BinaryOperator::AND, reg[i.c]);
+            break;
+
+        case Opcode::OR:
+            reg[i.a] = reg[i.b].doBinary(BinaryOperator::OR, reg[i.c]);
+            break;
+
+        case Opcode::EQU:
+            reg[i.a] = reg[i.b].doBinary(BinaryOperator::EQU, reg[i.c]);
+            break;
+
+        case Opcode::NEQ:
+            reg[i.a] = reg[i.b].doBinary(BinaryOperator::NEQ, reg[i.c]);
+            break;
+
+        case Opcode::LES:
+            reg[i.a] = reg[i.b].doBinary(BinaryOperator::LES, reg[i.c]);
+            break;
+
+        case Opcode::LEQ:
+            reg[i.a] = reg[i.b].doBinary(BinaryOperator::LEQ, reg[i.c]);
+            break;
+
+        case Opcode::GRT:
+            reg[i.a] = reg[i.b].doBinary(BinaryOperator::GRT, reg[i.c]);
+            break;
+
+        case Opcode::GEQ:
+            reg[i.a] = reg[i.b].doBinary(BinaryOperator::GEQ, reg[i.c]);
+            break;
+
+        case Opcode::NEG:
+            reg[i.a] = reg[i.b].doUnary(UnaryOperator::NEG);
+            break;
+
+        case Opcode::NOT:
+            reg[i.a] = reg[i.b].doUnary(UnaryOperator::NOT);
+            break;
+
+        case Opcode::CALL: {
+            vector<Datum> arguments(reg + i.b + 1, reg + i.b + 1 + i.c);
+            Program subscope(*scope);
+            reg[i.a] = reg[i.b].doCall(subscope, arguments);
+            break;
+        }
+
+        case Opcode::TAILCALL: {
+            vector<Datum> arguments(reg + i.b + 1, reg + i.b + 1 + i.c);
+            if (scope == &program && program.tailCall(reg[i.b], arguments)) {
+                return NullValue::singleton;
+            }
+
+            Program subscope(*scope);
+            return reg[i.b].doCall(subscope, arguments);
+        }
+
+        case Opcode::JUMP:
+            /* a hot loop continues in native code */
+            if (!single && jit && i.b < pc) {
+                if (!chunk.native && ++chunk.hotness == Jit::threshold) {
+                    chunk.native = Jit::compile(chunk);
+                }
+
+                if (chunk.native) {
+                    return enter(i.b);
+                }
+            }
+            pc = i.b;
+            break;
+
+        case Opcode::JUMPIFNOT:
+            if (!reg[i.a].isTrue()) {
+                pc = i.b;
+            }
+            break;
+
+        case Opcode::ENTER:
+            scopes.emplace_back(*scope, *chunk.layouts[i.b]);
+            scope = &scopes.back();
+            break;
+
+        case Opcode::RENEW:
+            scope->enter(*chunk.layouts[i.b]);
+            break;
+
+        case Opcode::LEAVE:
+            scopes.pop_back();
+            scope = scopes.empty() ? &program : &scopes.back();
+            break;
+
+        case Opcode::FORPREP: {
+            const auto& value = reg[i.a];
+            const bool range = value.getTag() == Datum::Tag::BOXED && dynamic_cast<RangeValue*>(value.getBoxed().get()) != nullptr;
+            reg[i.a + 1] = Datum(0LL);
+            reg[i.a + 4] = Datum(range);
+            break;
+        }
+
+        case Opcode::FORNEXT: {
+            const unsigned long long index = reg[i.a + 1].getInt();
+
+            /* a range is counted through, its numbers are never boxed */
+            if (reg[i.a + 4].getBool()) {
+                const auto& range = static_cast<RangeValue&>(*reg[i.a].getBoxed());
+                if (index >= range.count) {
+                    pc = i.b;
+                    break;
+                }
+
+                if (i.c) {
+                    reg[i.a + 2] = Datum((signed long long) index);
+                }
+                reg[i.a + 3] = Datum(range.at(index));
+                reg[i.a + 1] = Datum((signed long long) (index + 1));
+                break;
+            }
+
+            if (index >= reg[i.a].getLength()) {
+                pc = i.b;
+                break;
+            }
+
+            if (i.c) {
+                reg[i.a + 2] = reg[i.a].getKey(index);
+            }
+            reg[i.a + 3] = reg[i.a].getValue(index);
+            reg[i.a + 1] = Datum((signed long long) (index + 1));
+            break;
+        }
+
+        case Opcode::RETURN:
+            return reg[i.a];
+
+        case Opcode::END:
+            return nullptr;
+        }
+
+        if (single) {
+            branched = pc != entry + 1;
+            return nullptr;
+        }
+    }
+}
+
+} /* namespace noumenon */
@@ -0,0 +1,75 @@
+/*
+ * Noumenon: A dynamic, strongly typed script language.
+ * Copyright (C) 2015 Tim Wiederhake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef MACHINE_H_
+#define MACHINE_H_
+
+#include "Compiler.h"
+#include "Program.h"
+
+#include <deque>
+#include <exception>
+#include <memory>
+#include <vector>
+
+namespace noumenon {
+
+/* executes one chunk in the given scope, returns an empty Datum if the chunk did not return */
+class Machine {
+public:
+    Machine(Program&, Chunk&);
+
+    /* closes the scopes still open, innermost first, as the arena releases slots like a stack */
+    ~Machine();
+
+    Datum operator()();
+
+    /*
+     * Executes a single instruction on behalf of native code. Returns 1 if the
+     * instruction branches or leaves the chunk, 0 if it does not and -1 if it
+     * threw; the exception is rethrown once the native code has returned.
+     */
+    static int execute(Machine*, const Instruction*);
+
+    /* slot of a resolved variable in the current scope for native code, see Program::resolveVariable */
+    static Datum* locate(Machine*, const Variable*);
+
+private:
+    /* runs the chunk from the given instruction; if single is set, that instruction only */
+    template<bool single>
+    Datum run(const unsigned&);
+
+    /* runs the native code of the chunk from the given instruction */
+    Datum enter(const unsigned&);
+
+    Program& program;
+    Chunk& chunk;
+    std::vector<Datum> registers;
+    std::deque<Program> scopes;
+    Program* scope;
+    const bool jit;
+
+    /* state of native code, see execute */
+    bool branched;
+    Datum result;
+    std::exception_ptr error;
+};
+
+} /* namespace noumenon */
+
+#endif /* MACHINE_H_ */
@@ -0,0 +1,370 @@
+/*
+ * Noumenon: A dynamic, strongly typed script language.
+ * Copyright (C) 2015 Tim Wiederhake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#include "Modules.h"
+#include "Program.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace noumenon {
+
+static bool canonicalPath(const string& file, string& path) {
+    char buffer[PATH_MAX];
+    if (realpath(file.c_str(), buffer) == nullptr) {
+        return false;
+    }
+    path = buffer;
+    return true;
+}
+
+/* the file names of the literal require() and import() calls in a statement */
+struct DependencyScanner : public StatementWalker, public ExpressionWalker {
+    void walk(const vector<shared_ptr<Statement>>& statements) {
+        for (auto& statement : statements) {
+            statement->walk(*this);
+        }
+    }
+
+    void walk(const vector<shared_ptr<Expression>>& expressions) {
+        for (auto& expression : expressions) {
+            expression->walk(*this);
+        }
+    }
+
+    void call(VariableExpression& function, const vector<shared_ptr<Expression>>& expressions) {
+        function.walk(*this);
+        walk(expressions);
+
+        if (!function.expressions.empty() || expressions.empty()) {
+            return;
+        }
+        if (function.identifier != require && function.identifier != import) {
+            return;
+        }
+
+        const auto literal = dynamic_cast<StringExpression*>(expressions[0].get());
+        if (literal != nullptr) {
+            files.push_back(StringValue::UTF32toUTF8(literal->value));
+        }
+    }
+
+    Datum statement(AssignmentStatement& node) {
+        node.variable->walk(*this);
+        node.expression->walk(*this);
+        return nullptr;
+    }
+
+    Datum statement(CallStatement& node) {
+        call(*node.function, node.expressions);
+        return nullptr;
+    }
+
+    Datum statement(ForStatement& node) {
+        node.expression->walk(*this);
+        walk(node.statements);
+        return nullptr;
+    }
+
+    Datum statement(IfStatement& node) {
+        node.condition->walk(*this);
+        walk(node.statementsThen);
+        walk(node.statementsElse);
+        return nullptr;
+    }
+
+    Datum statement(ReturnStatement& node) {
+        node.expression->walk(*this);
+        return nullptr;
+    }
+
+    Datum statement(VarStatement& node) {
+        node.expression->walk(*this);
+        return nullptr;
+    }
+
+    Datum statement(WhileStatement& node) {
+        node.condition->walk(*this);
+        walk(node.statements);
+        return nullptr;
+    }
+
+    Datum expression(ArrayExpression& node) {
+        walk(node.expressions);
+        return nullptr;
+    }
+
+    Datum expression(BinaryExpression& node) {
+        node.lhs->walk(*this);
+        node.rhs->walk(*this);
+        return nullptr;
+    }
+
+    Datum expression(BoolExpression&) {
+        return nullptr;
+    }
+
+    Datum expression(CallExpression& node) {
+        call(*node.function, node.expressions);
+        return nullptr;
+    }
+
+    Datum expression(FloatExpression&) {
+        return nullptr;
+    }
+
+    Datum expression(FunctionExpression& node) {
+        walk(node.statements);
+        return nullptr;
+    }
+
+    Datum expression(IntExpression&) {
+        return nullptr;
+    }
+
+    Datum expression(NullExpression&) {
+        return nullptr;
+    }
+
+    Datum expression(ObjectExpression& node) {
+        for (auto& value : node.values) {
+            value.second->walk(*this);
+        }
+        return nullptr;
+    }
+
+    Datum expression(StringExpression&) {
+        return nullptr;
+    }
+
+    Datum expression(UnaryExpression& node) {
+        node.rhs->walk(*this);
+        return nullptr;
+    }
+
+    Datum expression(VariableExpression& node) {
+        walk(node.expressions);
+        return nullptr;
+    }
+
+    static const Atom require;
+    static const Atom import;
+    vector<string> files;
+};
+
+const Atom DependencyScanner::require = U"require";
+const Atom DependencyScanner::import = U"import";
+
+ModuleRegistry::ModuleRegistry() : modules(), lock(), condition(), requested(), queue(), prefetched(), workers(), stopping(false) {
+}
+
+ModuleRegistry::~ModuleRegistry() {
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    condition.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ModuleRegistry::prefetch(Statement& statement, const Cache* cache) {
+    DependencyScanner scanner;
+    statement.walk(scanner);
+    if (scanner.files.empty()) {
+        return;
+    }
+
+    lock_guard<mutex> guard(lock);
+    schedule(scanner.files, cache);
+}
+
+void ModuleRegistry::schedule(const vector<string>& files, const Cache* cache) {
+    for (auto& file : files) {
+        string path;
+        if (!canonicalPath(file, path) || !requested.insert(path).second) {
+            continue;
+        }
+
+        prefetched[path] = make_shared<Parsed>(Parsed {false, false, 0, 0, Cache::Writer(), {}});
+        queue.push_back(make_pair(path, cache));
+    }
+
+    if (workers.empty() && !queue.empty()) {
+        const auto count = max(thread::hardware_concurrency(), 1u);
+        for (unsigned i = 0; i < count; ++i) {
+            workers.push_back(thread(&ModuleRegistry::work, this));
+        }
+    }
+    condition.notify_all();
+}
+
+void ModuleRegistry::work() {
+    unique_lock<mutex> guard(lock);
+    while (true) {
+        condition.wait(guard, [this] {
+            return stopping || !queue.empty();
+        });
+        if (stopping) {
+            return;
+        }
+
+        const auto path = queue.front().first;
+        const auto cache = queue.front().second;
+        queue.pop_front();
+
+        /* the program may have parsed it already itself */
+        const auto& iterator = prefetched.find(path);
+        if (iterator == prefetched.end()) {
+            continue;
+        }
+        const auto parsed = iterator->second;
+        parsed->started = true;
+        guard.unlock();
+
+        DependencyScanner scanner;
+        struct stat status;
+        ifstream file(path);
+        if (stat(path.c_str(), &status) == 0 && file) {
+            parsed->seconds = status.st_mtim.tv_sec;
+            parsed->nanoseconds = status.st_mtim.tv_nsec;
+            const string text((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+            try {
+                parsed->trees = Program::parse(path, text.data(), text.size(), cache, parsed->statements);
+                scanner.walk(parsed->trees);
+            } catch (const string&) {
+                /* the program parses it again and reports the error */
+            }
+        }
+
+        guard.lock();
+        parsed->done = true;
+        schedule(scanner.files, cache);
+    }
+}
+
+void ModuleRegistry::adopt(Module& module) {
+    unique_lock<mutex> guard(lock);
+    const auto& iterator = prefetched.find(module.path);
+    if (iterator == prefetched.end()) {
+        return;
+    }
+
+    const auto parsed = iterator->second;
+    prefetched.erase(iterator);
+    if (!parsed->started) {
+        return;
+    }
+
+    condition.wait(guard, [&parsed] {
+        return parsed->done;
+    });
+    guard.unlock();
+
+    /* the file may have changed since */
+    if (parsed->statements.isComplete() && parsed->seconds == module.seconds && parsed->nanoseconds == module.nanoseconds) {
+        module.statements = std::move(parsed->statements);
+        module.parsed = std::move(parsed->trees);
+    }
+}
+
+ModuleRegistry::Module* ModuleRegistry::find(const string& file) {
+    string path;
+    struct stat status;
+    if (!canonicalPath(file, path) || stat(path.c_str(), &status) != 0 || S_ISDIR(status.st_mode)) {
+        return nullptr;
+    }
+
+    auto iterator = modules.find(path);
+    if (iterator == modules.end()) {
+        iterator = modules.insert(make_pair(path, Module {path, 0, 0, Cache::Writer(), {}, Datum(), 0, 0.0})).first;
+    }
+
+    auto& module = iterator->second;
+    if (module.seconds != status.st_mtim.tv_sec || module.nanoseconds != status.st_mtim.tv_nsec) {
+        module.seconds = status.st_mtim.tv_sec;
+        module.nanoseconds = status.st_mtim.tv_nsec;
+        module.statements = Cache::Writer();
+        module.parsed.clear();
+        module.value = Datum();
+    }
+
+    if (!module.statements.isComplete()) {
+        adopt(module);
+    }
+    return &module;
+}
+
+bool ModuleRegistry::reload(const string& file) {
+    string path;
+    if (!canonicalPath(file, path)) {
+        return false;
+    }
+
+    const auto& iterator = modules.find(path);
+    if (iterator == modules.end()) {
+        return false;
+    }
+
+    iterator->second.statements = Cache::Writer();
+    iterator->second.parsed.clear();
+    iterator->second.value = Datum();
+    return true;
+}
+
+const map<string, ModuleRegistry::Module>& ModuleRegistry::getModules() const {
+    return modules;
+}
+
+Datum ModuleRegistry::run(Program& program, Module& module) {
+    const auto start = chrono::steady_clock::now();
+
+    Datum returnValue;
+    if (!module.parsed.empty()) {
+        const auto statements = std::move(module.parsed);
+        module.parsed.clear();
+        returnValue = Program::execute(program, statements);
+    } else if (module.statements.isComplete()) {
+        returnValue = Program::execute(program, module.statements.read());
+    } else {
+        ifstream file(module.path);
+        if (!file) {
+            return Datum();
+        }
+        const string text((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+
+        /* a module that fails to parse is parsed again the next time */
+        module.statements = Cache::Writer();
+        returnValue = Program::execute(program, module.path, text.data(), text.size(), &module.statements);
+    }
+
+    module.loads += 1;
+    module.time += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return returnValue;
+}
+
+} /* namespace noumenon */
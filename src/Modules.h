@@ -0,0 +1,116 @@
+/*
+ * Noumenon: A dynamic, strongly typed script language.
+ * Copyright (C) 2015 Tim Wiederhake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef MODULES_H_
+#define MODULES_H_
+
+#include "Cache.h"
+#include "Value.h"
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+namespace noumenon {
+
+class Program;
+
+/*
+ * Scripts loaded with require() or import(), by canonical path. A module is
+ * parsed once and keeps its syntax trees, so running it again only rebuilds
+ * them; import() runs it once and keeps its return value. Whatever is known
+ * of a module is forgotten when its file's modification time changes or it
+ * is reloaded explicitly.
+ */
+class ModuleRegistry {
+public:
+    struct Module {
+        std::string path;
+
+        /* modification time of the file when it was parsed */
+        long long seconds;
+        long long nanoseconds;
+
+        /* complete once the module was parsed without errors */
+        Cache::Writer statements;
+
+        /* syntax trees a worker parsed ahead, used by the next run instead of rebuilding them */
+        std::vector<std::shared_ptr<Statement>> parsed;
+
+        /* return value of the module, once import() ran it */
+        Datum value;
+
+        /* runs and the time spent parsing and running, for modules() */
+        unsigned long long loads;
+        double time;
+    };
+
+    ModuleRegistry();
+    ~ModuleRegistry();
+
+    /* starts parsing the scripts a statement requires by string literal, using the cache if one is given */
+    void prefetch(Statement&, const Cache*);
+
+    /* the module of a file that exists, up to date with its modification time; nullptr otherwise */
+    Module* find(const std::string& file);
+
+    /* forgets the statements and the value of a module; returns false if it is not known */
+    bool reload(const std::string& file);
+
+    const std::map<std::string, Module>& getModules() const;
+
+    /* runs a module in the given scope, returns an empty Datum if its file cannot be read */
+    static Datum run(Program&, Module&);
+
+private:
+    /* a script parsed by a worker */
+    struct Parsed {
+        bool started;
+        bool done;
+        long long seconds;
+        long long nanoseconds;
+        Cache::Writer statements;
+        std::vector<std::shared_ptr<Statement>> trees;
+    };
+
+    /* takes the statements parsed by a worker, waits for it if it is parsing the module right now */
+    void adopt(Module&);
+
+    /* queues the scripts for the workers that were not queued before, the lock must be held */
+    void schedule(const std::vector<std::string>& files, const Cache*);
+    void work();
+
+    std::map<std::string, Module> modules;
+
+    /* shared with the workers */
+    std::mutex lock;
+    std::condition_variable condition;
+    std::set<std::string> requested;
+    std::deque<std::pair<std::string, const Cache*>> queue;
+    std::map<std::string, std::shared_ptr<Parsed>> prefetched;
+    std::vector<std::thread> workers;
+    bool stopping;
+};
+
+} /* namespace noumenon */
+
+#endif /* MODULES_H_ */
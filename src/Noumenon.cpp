@@ -17,15 +17,22 @@
  */
 
 #include "Expression.h"
+#include "Output.h"
 #include "Runtime.h"
 #include "Statement.h"
 #include "Value.h"
 
 #include <fstream>
 #include <iostream>
+#include <iterator>
 #include <memory>
 #include "Program.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 using namespace std;
 
 static void usage() {
@@ -34,6 +41,11 @@ static void usage() {
         << "Options:"
         << endl
         << "  --quiet, -q       Don't show intro" << endl
+        << "  --engine=ENGINE   Execute with ENGINE, one of \"ast\" (default) or \"vm\"" << endl
+        << "  --jit, --no-jit   Compile hot functions and loops to native code, or don't (default)" << endl
+        << "  --cache=DIR       Keep parsed scripts in DIR to skip parsing them again" << endl
+        << "  --output=MODE     Write output a line or a block at a time, MODE is one of \"line\" or \"block\"," << endl
+        << "                    default is \"line\" for a terminal and \"block\" otherwise" << endl
         << endl
         << "If FILE is not given or \"--\", use interactive mode." << endl;
 }
@@ -45,7 +57,19 @@ int main(int, char* argv[], char** env) {
 
         /* parameter --quiet / -q */
         bool quiet;
-    } options = {"", false};
+
+        /* parameter --engine */
+        noumenon::Engine engine;
+
+        /* parameter --jit / --no-jit */
+        bool jit;
+
+        /* parameter --cache */
+        string cache;
+
+        /* parameter --output */
+        noumenon::Output::Buffering output;
+    } options = {"", false, noumenon::Engine::WALKER, false, "", noumenon::Output::Buffering::AUTOMATIC};
 
     /* parse noumenon arguments */
     for(argv++; *argv; argv += 1) {
@@ -63,6 +87,20 @@ int main(int, char* argv[], char** env) {
 
         if (arg == "--quiet" || arg == "-q") {
             options.quiet = true;
+        } else if (arg == "--engine=ast") {
+            options.engine = noumenon::Engine::WALKER;
+        } else if (arg == "--engine=vm") {
+            options.engine = noumenon::Engine::MACHINE;
+        } else if (arg == "--jit") {
+            options.jit = true;
+        } else if (arg == "--no-jit") {
+            options.jit = false;
+        } else if (arg.compare(0, 8, "--cache=") == 0 && arg.size() > 8) {
+            options.cache = arg.substr(8);
+        } else if (arg == "--output=line") {
+            options.output = noumenon::Output::Buffering::LINE;
+        } else if (arg == "--output=block") {
+            options.output = noumenon::Output::Buffering::BLOCK;
         } else {
             cout << "Unknown option '" << arg << "'" << endl << endl;
             usage();
@@ -79,28 +117,41 @@ int main(int, char* argv[], char** env) {
     /* program arguments */
     const auto& arguments = make_shared<noumenon::ArrayValue>();
     for(; *argv; argv += 1) {
-        arguments->values.emplace_back(make_shared<noumenon::StringValue>(noumenon::StringValue::UTF8toUTF32(*argv)));
+        arguments->doAppend(make_shared<noumenon::StringValue>(noumenon::StringValue::UTF8toUTF32(*argv)));
     }
 
-    const auto& environment = make_shared<noumenon::ObjectValue>();
+    map<u32string, noumenon::Datum> variables;
     for(;*env; ++env) {
         const string line(*env);
         const auto& pos = line.find('=');
         if(pos != line.npos) {
-            environment->values[noumenon::StringValue::UTF8toUTF32(line.substr(0, pos))] = make_shared<noumenon::StringValue>(noumenon::StringValue::UTF8toUTF32(line.substr(pos + 1)));
+            variables[noumenon::StringValue::UTF8toUTF32(line.substr(0, pos))] = make_shared<noumenon::StringValue>(noumenon::StringValue::UTF8toUTF32(line.substr(pos + 1)));
         }
     }
+    const auto& environment = make_shared<noumenon::ObjectValue>(variables);
 
-    noumenon::Program program(options.quiet);
+    noumenon::Output::standard.setBuffering(options.output);
+
+    noumenon::Program program(options.quiet, options.engine, options.jit);
+    if (!options.cache.empty()) {
+        program.useCache(options.cache);
+    }
     program.insertVariable(U"arg", arguments);
     program.insertVariable(U"env", environment);
 
     program.insertVariable(U"typeof", make_shared<noumenon::rtl::Typeof>());
     program.insertVariable(U"print", make_shared<noumenon::rtl::Print>());
     program.insertVariable(U"println", make_shared<noumenon::rtl::Println>());
+    program.insertVariable(U"flush", make_shared<noumenon::rtl::Flush>());
     program.insertVariable(U"range", make_shared<noumenon::rtl::Range>());
     program.insertVariable(U"length", make_shared<noumenon::rtl::Length>());
+    program.insertVariable(U"shift", make_shared<noumenon::rtl::Shift>());
+    program.insertVariable(U"pop", make_shared<noumenon::rtl::Pop>());
+    program.insertVariable(U"slice", make_shared<noumenon::rtl::Slice>());
     program.insertVariable(U"require", make_shared<noumenon::rtl::Require>());
+    program.insertVariable(U"import", make_shared<noumenon::rtl::Import>());
+    program.insertVariable(U"reload", make_shared<noumenon::rtl::Reload>());
+    program.insertVariable(U"modules", make_shared<noumenon::rtl::Modules>());
 
     if (options.file.empty() || options.file == "--") {
         program.insertVariable(U"list", make_shared<noumenon::rtl::List>());
@@ -126,6 +177,8 @@ int main(int, char* argv[], char** env) {
                     return c;
                 }
 
+                /* what was printed so far shows before waiting for input */
+                noumenon::Output::standard.flush();
                 int value = cin.get();
                 c = value;
 
@@ -146,30 +199,76 @@ int main(int, char* argv[], char** env) {
             try {
                 const auto& returnValue = noumenon::Program::execute(program, input);
                 noumenon::rtl::Println println;
-                std::vector<std::shared_ptr<noumenon::Value>> arguments = {returnValue};
+                std::vector<noumenon::Datum> arguments = {returnValue};
                 println.doCall(program, arguments);
             } catch (const string& s) {
+                noumenon::Output::standard.flush();
                 cout << "driver: " << s << endl;
             }
         }
 
     } else {
-        ifstream input(options.file);
+        /* a regular file is mapped into memory, anything else is read as a whole */
+        struct Source {
+            Source(const string& path) : text(), data(nullptr), size(0), mapped(nullptr), valid(false) {
+                const auto descriptor = open(path.c_str(), O_RDONLY);
+                if (descriptor < 0) {
+                    return;
+                }
+
+                struct stat status;
+                if (fstat(descriptor, &status) != 0 || S_ISDIR(status.st_mode)) {
+                    close(descriptor);
+                    return;
+                }
+
+                if (S_ISREG(status.st_mode) && status.st_size > 0) {
+                    const auto memory = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+                    if (memory != MAP_FAILED) {
+                        mapped = memory;
+                        data = static_cast<const char*>(memory);
+                        size = status.st_size;
+                        valid = true;
+                    }
+                }
+                close(descriptor);
+
+                if (!valid) {
+                    ifstream input(path);
+                    text.assign(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+                    data = text.data();
+                    size = text.size();
+                    valid = !input.bad();
+                }
+            }
+
+            ~Source() {
+                if (mapped != nullptr) {
+                    munmap(mapped, size);
+                }
+            }
+
+            string text;
+            const char* data;
+            size_t size;
+            void* mapped;
+            bool valid;
+        } source(options.file);
 
-        if (!input) {
+        if (!source.valid) {
             cout << "Unreadable file: " << options.file << endl << endl;
             usage();
             return 1;
         }
 
         try {
-            const auto& returnValue = noumenon::Program::execute(program, input);
+            const auto& returnValue = noumenon::Program::execute(program, options.file, source.data, source.size);
 
             struct Walker : public noumenon::DefaultValueWalker {
                 Walker() : result(0), valid(false) {
                 }
 
-                shared_ptr<noumenon::Value> value(noumenon::IntValue& node) {
+                noumenon::Datum value(noumenon::IntValue& node) {
                     result = node.value;
                     valid = true;
                     return nullptr;
@@ -179,11 +278,12 @@ int main(int, char* argv[], char** env) {
                 bool valid;
             } walker;
 
-            returnValue->walk(walker);
+            returnValue.walk(walker);
             if (walker.valid) {
                 return walker.result;
             }
         } catch (const string& s) {
+            noumenon::Output::standard.flush();
             cout << "driver: " << s << endl;
             return 1;
         }
@@ -0,0 +1,683 @@
+/*
+ * Noumenon: A dynamic, strongly typed script language.
+ * Copyright (C) 2015 Tim Wiederhake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+#include "Optimizer.h"
+#include "Program.h"
+#include "Resolver.h"
+
+#include <limits.h>
+
+using namespace std;
+
+namespace noumenon {
+
+/* result of a binary operator on constants, or nothing if it overflows or traps and has to be left for run time */
+static Datum binary(const Datum& lhs, const BinaryOperator& oper, const Datum& rhs) {
+    if (lhs.getType() == Type::INT && rhs.getType() == Type::INT) {
+        const auto a = lhs.getInt();
+        const auto b = rhs.getInt();
+        switch (oper) {
+        case BinaryOperator::ADD:
+            if ((b > 0 && a > LLONG_MAX - b) || (b < 0 && a < LLONG_MIN - b)) {
+                return nullptr;
+            }
+            break;
+        case BinaryOperator::SUB:
+            if ((b < 0 && a > LLONG_MAX + b) || (b > 0 && a < LLONG_MIN + b)) {
+                return nullptr;
+            }
+            break;
+        case BinaryOperator::MUL:
+            if (a != 0 && b != 0) {
+                if ((a == -1 && b == LLONG_MIN) || (b == -1 && a == LLONG_MIN)) {
+                    return nullptr;
+                }
+                if (a != -1 && b != -1) {
+                    const auto product = static_cast<unsigned long long>(a) * static_cast<unsigned long long>(b);
+                    if (static_cast<signed long long>(product) / b != a) {
+                        return nullptr;
+                    }
+                }
+            }
+            break;
+        case BinaryOperator::DIV:
+        case BinaryOperator::MOD:
+            if (b == 0 || (a == LLONG_MIN && b == -1)) {
+                return nullptr;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return lhs.doBinary(oper, rhs);
+}
+
+/* result of a unary operator on a constant, or nothing if it overflows */
+static Datum unary(const UnaryOperator& oper, const Datum& rhs) {
+    if (oper == UnaryOperator::NEG && rhs.getType() == Type::INT && rhs.getInt() == LLONG_MIN) {
+        return nullptr;
+    }
+    return rhs.doUnary(oper);
+}
+
+/* value of an expression built from literals and known variables of the outermost scope */
+class Evaluator : public ExpressionWalker {
+public:
+    Evaluator(const map<Atom, Datum>& names) : names(names) {
+    }
+
+    Datum expression(ArrayExpression&) {
+        return nullptr;
+    }
+
+    Datum expression(BinaryExpression& node) {
+        const auto lhs = node.lhs->walk(*this);
+        const auto rhs = node.rhs->walk(*this);
+        if (lhs.isEmpty() || rhs.isEmpty()) {
+            return nullptr;
+        }
+        return binary(lhs, node.oper, rhs);
+    }
+
+    Datum expression(BoolExpression& node) {
+        return Datum(node.value);
+    }
+
+    Datum expression(CallExpression&) {
+        return nullptr;
+    }
+
+    Datum expression(FloatExpression& node) {
+        return Datum(node.value);
+    }
+
+    Datum expression(FunctionExpression&) {
+        return nullptr;
+    }
+
+    Datum expression(IntExpression& node) {
+        return Datum(node.value);
+    }
+
+    Datum expression(NullExpression&) {
+        return NullValue::singleton;
+    }
+
+    Datum expression(ObjectExpression&) {
+        return nullptr;
+    }
+
+    Datum expression(StringExpression&) {
+        return nullptr;
+    }
+
+    Datum expression(UnaryExpression& node) {
+        const auto rhs = node.rhs->walk(*this);
+        if (rhs.isEmpty()) {
+            return nullptr;
+        }
+        return unary(node.oper, rhs);
+    }
+
+    Datum expression(VariableExpression& node) {
+        if (node.address.resolved || !node.expressions.empty()) {
+            return nullptr;
+        }
+
+        const auto& fact = names.find(node.identifier);
+        if (fact == names.end()) {
+            return nullptr;
+        }
+        return fact->second;
+    }
+
+private:
+    const map<Atom, Datum>& names;
+};
+
+/*
+ * Collects assigned names and tells whether calls happen outside of function
+ * bodies. Branches that are dead given the known variables of the outermost
+ * scope are skipped, as a loop containing calls only there never makes them.
+ */
+class Scanner : public StatementWalker, public ExpressionWalker {
+public:
+    Scanner(set<Atom>& assigned, const map<Atom, Datum>& names) : assigned(assigned), calls(false), names(names), functions(0) {
+    }
+
+    Datum statement(AssignmentStatement& node) {
+        assigned.insert(node.variable->identifier);
+        node.expression->walk(*this);
+        node.variable->walk(*this);
+        return nullptr;
+    }
+
+    Datum statement(CallStatement& node) {
+        call(*node.function, node.expressions);
+        return nullptr;
+    }
+
+    Datum statement(ForStatement& node) {
+        node.expression->walk(*this);
+        walk(node.statements);
+        return nullptr;
+    }
+
+    Datum statement(IfStatement& node) {
+        node.condition->walk(*this);
+
+        const auto condition = constant(*node.condition);
+        if (condition.isEmpty() || condition.isTrue()) {
+            walk(node.statementsThen);
+        }
+        if (condition.isEmpty() || !condition.isTrue()) {
+            walk(node.statementsElse);
+        }
+        return nullptr;
+    }
+
+    Datum statement(ReturnStatement& node) {
+        node.expression->walk(*this);
+        return nullptr;
+    }
+
+    Datum statement(VarStatement& node) {
+        node.expression->walk(*this);
+        return nullptr;
+    }
+
+    Datum statement(WhileStatement& node) {
+        node.condition->walk(*this);
+
+        const auto condition = constant(*node.condition);
+        if (condition.isEmpty() || condition.isTrue()) {
+            walk(node.statements);
+        }
+        return nullptr;
+    }
+
+    Datum expression(ArrayExpression& node) {
+        walk(node.expressions);
+        return nullptr;
+    }
+
+    Datum expression(BinaryExpression& node) {
+        node.lhs->walk(*this);
+        node.rhs->walk(*this);
+        return nullptr;
+    }
+
+    Datum expression(BoolExpression&) {
+        return nullptr;
+    }
+
+    Datum expression(CallExpression& node) {
+        call(*node.function, node.expressions);
+        return nullptr;
+    }
+
+    Datum expression(FloatExpression&) {
+        return nullptr;
+    }
+
+    Datum expression(FunctionExpression& node) {
+        functions += 1;
+        walk(node.statements);
+        functions -= 1;
+        return nullptr;
+    }
+
+    Datum expression(IntExpression&) {
+        return nullptr;
+    }
+
+    Datum expression(NullExpression&) {
+        return nullptr;
+    }
+
+    Datum expression(ObjectExpression& node) {
+        for (auto& pair : node.values) {
+            pair.second->walk(*this);
+        }
+        return nullptr;
+    }
+
+    Datum expression(StringExpression&) {
+        return nullptr;
+    }
+
+    Datum expression(UnaryExpression& node) {
+        node.rhs->walk(*this);
+        return nullptr;
+    }
+
+    Datum expression(VariableExpression& node) {
+        walk(node.expressions);
+        return nullptr;
+    }
+
+    set<Atom>& assigned;
+    bool calls;
+
+private:
+    Datum constant(Expression& expression) {
+        /* function bodies are not run where they are defined */
+        if (functions != 0) {
+            return nullptr;
+        }
+
+        Evaluator evaluator(names);
+        return expression.walk(evaluator);
+    }
+
+    void call(VariableExpression& function, const vector<shared_ptr<Expression>>& expressions) {
+        if (functions == 0) {
+            calls = true;
+        }
+        walk(expressions);
+        function.walk(*this);
+    }
+
+    void walk(const vector<shared_ptr<Statement>>& statements) {
+        for (auto& statement : statements) {
+            statement->walk(*this);
+        }
+    }
+
+    void walk(const vector<shared_ptr<Expression>>& expressions) {
+        for (auto& expression : expressions) {
+            expression->walk(*this);
+        }
+    }
+
+    const map<Atom, Datum>& names;
+    unsigned functions;
+};
+
+/* syntax tree node for a constant value, nullptr if there is none */
+static shared_ptr<Expression> literal(const Datum& value) {
+    switch (value.getTag()) {
+    case Datum::Tag::NUL:
+        return make_shared<NullExpression>();
+
+    case Datum::Tag::BOOL: {
+        auto expression = make_shared<BoolExpression>();
+        expression->value = value.getBool();
+        return expression;
+    }
+
+    case Datum::Tag::INT: {
+        auto expression = make_shared<IntExpression>();
+        expression->value = value.getInt();
+        return expression;
+    }
+
+    case Datum::Tag::FLOAT: {
+        auto expression = make_shared<FloatExpression>();
+        expression->value = value.getFloat();
+        return expression;
+    }
+
+    case Datum::Tag::BOXED: {
+        struct Walker : public DefaultValueWalker {
+            Datum value(StringValue&) {
+                return Datum(true);
+            }
+        } walker;
+
+        if (!value.walk(walker).isTrue()) {
+            break;
+        }
+
+        auto expression = make_shared<StringExpression>();
+        expression->constant = static_pointer_cast<StringValue>(value.getBoxed());
+        expression->value = expression->constant->toUTF32();
+        return expression;
+    }
+
+    default:
+        break;
+    }
+
+    return nullptr;
+}
+
+void Optimizer::Facts::intersect(const Facts& other) {
+    for (auto iterator = slots.begin(); iterator != slots.end();) {
+        if (other.slots.find(iterator->first) == other.slots.end()) {
+            iterator = slots.erase(iterator);
+        } else {
+            ++iterator;
+        }
+    }
+
+    for (auto iterator = names.begin(); iterator != names.end();) {
+        if (other.names.find(iterator->first) == other.names.end()) {
+            iterator = names.erase(iterator);
+        } else {
+            ++iterator;
+        }
+    }
+}
+
+Optimizer::Optimizer() : assigned(), globals(), program(nullptr), levels(), facts(), declared(), replacement(), replaced(false) {
+}
+
+vector<shared_ptr<Statement>> Optimizer::optimize(shared_ptr<Statement> statement, Program& program) {
+    Scanner scanner(assigned, map<Atom, Datum>());
+    statement->walk(scanner);
+    for (auto iterator = globals.begin(); iterator != globals.end();) {
+        if (assigned.find(iterator->first) != assigned.end()) {
+            iterator = globals.erase(iterator);
+        } else {
+            ++iterator;
+        }
+    }
+
+    this->program = &program;
+    levels.clear();
+    facts = Facts();
+    declared.clear();
+
+    /* a nested program, e.g. a required file, has variables of its own */
+    if (program.getParent() == nullptr) {
+        facts.names = globals;
+    }
+
+    vector<shared_ptr<Statement>> statements = {statement};
+    block(statements, nullptr);
+    return statements;
+}
+
+Datum Optimizer::fold(shared_ptr<Expression>& expression) {
+    const auto value = expression->walk(*this);
+    if (value.isEmpty()) {
+        return value;
+    }
+
+    auto node = literal(value);
+    if (!node) {
+        return nullptr;
+    }
+
+    expression = node;
+    return value;
+}
+
+void Optimizer::fold(vector<shared_ptr<Expression>>& expressions) {
+    for (auto& expression : expressions) {
+        fold(expression);
+    }
+}
+
+void Optimizer::block(vector<shared_ptr<Statement>>& statements, const shared_ptr<Layout>& layout) {
+    if (layout) {
+        levels.push_back(layout.get());
+    }
+
+    vector<shared_ptr<Statement>> result;
+    for (auto& statement : statements) {
+        replaced = false;
+        statement->walk(*this);
+
+        if (replaced) {
+            result.insert(result.end(), replacement.begin(), replacement.end());
+        } else {
+            result.push_back(statement);
+        }
+    }
+    statements.swap(result);
+    replaced = false;
+
+    if (layout) {
+        levels.pop_back();
+
+        for (auto iterator = facts.slots.begin(); iterator != facts.slots.end();) {
+            if (iterator->first.first == layout.get()) {
+                iterator = facts.slots.erase(iterator);
+            } else {
+                ++iterator;
+            }
+        }
+    }
+}
+
+void Optimizer::call() {
+    /* the callee may assign any variable visible to it */
+    facts.slots.clear();
+    facts.names.clear();
+}
+
+Datum Optimizer::statement(AssignmentStatement& node) {
+    fold(node.expression);
+    if (node.append != node.expression) {
+        node.append = nullptr;
+    }
+    node.variable->walk(*this);
+    return nullptr;
+}
+
+Datum Optimizer::statement(CallStatement& node) {
+    fold(node.expressions);
+    node.function->walk(*this);
+    call();
+    return nullptr;
+}
+
+Datum Optimizer::statement(ForStatement& node) {
+    fold(node.expression);
+
+    Scanner scanner(assigned, facts.names);
+    for (auto& statement : node.statements) {
+        statement->walk(scanner);
+    }
+    if (scanner.calls) {
+        call();
+    }
+
+    /* the loop variables are defined before the body runs */
+    if (!node.key.empty()) {
+        declared.insert(Slot(node.layout.get(), node.keyAddress.slot));
+    }
+    declared.insert(Slot(node.layout.get(), node.valueAddress.slot));
+
+    block(node.statements, node.layout);
+    return nullptr;
+}
+
+Datum Optimizer::statement(IfStatement& node) {
+    const auto condition = fold(node.condition);
+
+    if (!condition.isEmpty()) {
+        const bool taken = condition.isTrue();
+        auto& statements = taken ? node.statementsThen : node.statementsElse;
+        auto& layout = taken ? node.layoutThen : node.layoutElse;
+        block(statements, layout);
+
+        /* without variables of its own the branch can run in the enclosing scope */
+        if (!layout) {
+            replacement = statements;
+            replaced = true;
+            return nullptr;
+        }
+
+        auto always = make_shared<BoolExpression>();
+        always->value = true;
+        node.condition = always;
+        if (!taken) {
+            node.statementsThen.swap(node.statementsElse);
+            node.layoutThen = node.layoutElse;
+        }
+        node.statementsElse.clear();
+        node.layoutElse = nullptr;
+        return nullptr;
+    }
+
+    const auto before = facts;
+    block(node.statementsThen, node.layoutThen);
+    const auto afterThen = facts;
+
+    facts = before;
+    block(node.statementsElse, node.layoutElse);
+    facts.intersect(afterThen);
+    return nullptr;
+}
+
+Datum Optimizer::statement(ReturnStatement& node) {
+    fold(node.expression);
+    return nullptr;
+}
+
+Datum Optimizer::statement(VarStatement& node) {
+    const auto value = fold(node.expression);
+
+    if (node.address.resolved) {
+        /* a redefinition keeps the value of the first definition */
+        const Slot slot(levels.back(), node.address.slot);
+        if (declared.insert(slot).second && !value.isEmpty() && assigned.find(node.identifier) == assigned.end()) {
+            facts.slots[slot] = value;
+        }
+        return nullptr;
+    }
+
+    if (value.isEmpty() || assigned.find(node.identifier) != assigned.end()) {
+        return nullptr;
+    }
+
+    if (program->getParent() == nullptr && !program->hasVariable(node.identifier)) {
+        globals[node.identifier] = value;
+        facts.names[node.identifier] = value;
+    }
+    return nullptr;
+}
+
+Datum Optimizer::statement(WhileStatement& node) {
+    /* calls in the loop invalidate what is known on every iteration */
+    Scanner scanner(assigned, facts.names);
+    node.walk(scanner);
+    if (scanner.calls) {
+        call();
+    }
+
+    const auto condition = fold(node.condition);
+    if (!condition.isEmpty() && !condition.isTrue()) {
+        replacement.clear();
+        replaced = true;
+        return nullptr;
+    }
+
+    block(node.statements, node.layout);
+    return nullptr;
+}
+
+Datum Optimizer::expression(ArrayExpression& node) {
+    fold(node.expressions);
+    return nullptr;
+}
+
+Datum Optimizer::expression(BinaryExpression& node) {
+    const auto lhs = fold(node.lhs);
+    const auto rhs = fold(node.rhs);
+    if (lhs.isEmpty() || rhs.isEmpty()) {
+        return nullptr;
+    }
+    return binary(lhs, node.oper, rhs);
+}
+
+Datum Optimizer::expression(BoolExpression& node) {
+    return Datum(node.value);
+}
+
+Datum Optimizer::expression(CallExpression& node) {
+    fold(node.expressions);
+    node.function->walk(*this);
+    call();
+    return nullptr;
+}
+
+Datum Optimizer::expression(FloatExpression& node) {
+    return Datum(node.value);
+}
+
+Datum Optimizer::expression(FunctionExpression& node) {
+    /* the body runs when called, not where it is defined */
+    const auto saved = facts;
+    facts = Facts();
+
+    for (auto& parameter : node.layout->parameters) {
+        declared.insert(Slot(node.layout.get(), parameter));
+    }
+    block(node.statements, node.layout);
+
+    facts = saved;
+    return nullptr;
+}
+
+Datum Optimizer::expression(IntExpression& node) {
+    return Datum(node.value);
+}
+
+Datum Optimizer::expression(NullExpression&) {
+    return NullValue::singleton;
+}
+
+Datum Optimizer::expression(ObjectExpression& node) {
+    for (auto& pair : node.values) {
+        fold(pair.second);
+    }
+    return nullptr;
+}
+
+Datum Optimizer::expression(StringExpression& node) {
+    if (!node.constant) {
+        node.constant = make_shared<StringValue>(node.value);
+    }
+    return node.constant;
+}
+
+Datum Optimizer::expression(UnaryExpression& node) {
+    const auto rhs = fold(node.rhs);
+    if (rhs.isEmpty()) {
+        return nullptr;
+    }
+    return unary(node.oper, rhs);
+}
+
+Datum Optimizer::expression(VariableExpression& node) {
+    Datum value;
+    if (node.address.resolved) {
+        const Slot slot(levels[levels.size() - 1 - node.address.depth], node.address.slot);
+        const auto& fact = facts.slots.find(slot);
+        if (fact != facts.slots.end()) {
+            value = fact->second;
+        }
+    } else {
+        const auto& fact = facts.names.find(node.identifier);
+        if (fact != facts.names.end()) {
+            value = fact->second;
+        }
+    }
+
+    fold(node.expressions);
+    if (!node.expressions.empty()) {
+        return nullptr;
+    }
+    return value;
+}
+
+} /* namespace noumenon */
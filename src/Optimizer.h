@@ -0,0 +1,108 @@
+/*
+ * Noumenon: A dynamic, strongly typed script language.
+ * Copyright (C) 2015 Tim Wiederhake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+#ifndef OPTIMIZER_H_
+#define OPTIMIZER_H_
+
+#include "Expression.h"
+#include "Statement.h"
+#include "Value.h"
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace noumenon {
+
+class Program;
+
+/*
+ * Rewrites resolved statements before they are executed: operators on
+ * literals are folded, variables holding literals are replaced by them and
+ * if and while statements with literal conditions lose their dead branches.
+ *
+ * Functions are dynamically scoped, so any call may change any variable it
+ * can see by name. Known values are therefore forgotten at every call, and
+ * variables that are assigned anywhere in the code seen so far are never
+ * considered constant. Variables of the outermost scope are remembered from
+ * one statement to the next, as each is optimized right before it runs.
+ */
+class Optimizer : public StatementWalker, public ExpressionWalker {
+public:
+    Optimizer();
+
+    std::vector<std::shared_ptr<Statement>> optimize(std::shared_ptr<Statement>, Program&);
+
+    Datum statement(AssignmentStatement&);
+    Datum statement(CallStatement&);
+    Datum statement(ForStatement&);
+    Datum statement(IfStatement&);
+    Datum statement(ReturnStatement&);
+    Datum statement(VarStatement&);
+    Datum statement(WhileStatement&);
+
+    /* returns the value of constant expressions, an empty Datum otherwise */
+    Datum expression(ArrayExpression&);
+    Datum expression(BinaryExpression&);
+    Datum expression(BoolExpression&);
+    Datum expression(CallExpression&);
+    Datum expression(FloatExpression&);
+    Datum expression(FunctionExpression&);
+    Datum expression(IntExpression&);
+    Datum expression(NullExpression&);
+    Datum expression(ObjectExpression&);
+    Datum expression(StringExpression&);
+    Datum expression(UnaryExpression&);
+    Datum expression(VariableExpression&);
+
+private:
+    typedef std::pair<const Layout*, unsigned> Slot;
+
+    /* values known at the current point of execution */
+    struct Facts {
+        std::map<Slot, Datum> slots;
+        std::map<Atom, Datum> names;
+
+        void intersect(const Facts&);
+    };
+
+    Datum fold(std::shared_ptr<Expression>&);
+    void fold(std::vector<std::shared_ptr<Expression>>&);
+    void block(std::vector<std::shared_ptr<Statement>>&, const std::shared_ptr<Layout>&);
+    void call();
+
+    /* names assigned anywhere in the code seen so far */
+    std::set<Atom> assigned;
+
+    /* literal values of variables of the outermost scope */
+    std::map<Atom, Datum> globals;
+
+    /* state while optimizing a statement */
+    Program* program;
+    std::vector<const Layout*> levels;
+    Facts facts;
+    std::set<Slot> declared;
+    std::vector<std::shared_ptr<Statement>> replacement;
+    bool replaced;
+};
+
+} /* namespace noumenon */
+
+#endif /* OPTIMIZER_H_ */
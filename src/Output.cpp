@@ -0,0 +1,138 @@
+/*
+ * Noumenon: A dynamic, strongly typed script language.
+ * Copyright (C) 2015 Tim Wiederhake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#include "Output.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <unistd.h>
+
+using namespace std;
+
+namespace noumenon {
+
+Output Output::standard(STDOUT_FILENO);
+
+Output::Output(const int& descriptor) : descriptor(descriptor), lineBuffered(isatty(descriptor)), buffer(new char[capacity]), used(0) {
+}
+
+Output::~Output() {
+    flush();
+}
+
+void Output::setBuffering(const Buffering& buffering) {
+    switch (buffering) {
+    case Buffering::AUTOMATIC:
+        lineBuffered = isatty(descriptor);
+        break;
+    case Buffering::LINE:
+        lineBuffered = true;
+        break;
+    case Buffering::BLOCK:
+        lineBuffered = false;
+        break;
+    }
+}
+
+void Output::write(const char* text, const size_t& size) {
+    if (used + size > capacity) {
+        flush();
+    }
+
+    if (size > capacity) {
+        for (size_t written = 0; written < size;) {
+            const auto result = ::write(descriptor, text + written, size - written);
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            if (result <= 0) {
+                return;
+            }
+            written += result;
+        }
+        return;
+    }
+
+    memcpy(buffer.get() + used, text, size);
+    used += size;
+
+    if (lineBuffered && memchr(text, '\n', size) != nullptr) {
+        flush();
+    }
+}
+
+void Output::write(const string& text) {
+    write(text.data(), text.size());
+}
+
+void Output::write(const char& c) {
+    if (used == capacity) {
+        flush();
+    }
+
+    buffer[used++] = c;
+    if (lineBuffered && c == '\n') {
+        flush();
+    }
+}
+
+void Output::write(const signed long long& value) {
+    /* digits from the back, negated so that the smallest value does not overflow */
+    char digits[24];
+    auto position = sizeof(digits);
+    auto rest = value < 0 ? value : -value;
+    do {
+        digits[--position] = '0' - rest % 10;
+        rest /= 10;
+    } while (rest != 0);
+
+    if (value < 0) {
+        digits[--position] = '-';
+    }
+    write(digits + position, sizeof(digits) - position);
+}
+
+void Output::write(const double& value) {
+    char digits[32];
+    const auto length = snprintf(digits, sizeof(digits), "%g", value);
+    if (length > 0) {
+        write(digits, length);
+    }
+}
+
+void Output::line() {
+    write('\n');
+}
+
+void Output::flush() {
+    for (size_t written = 0; written < used;) {
+        const auto result = ::write(descriptor, buffer.get() + written, used - written);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            break;
+        }
+        written += result;
+    }
+    used = 0;
+}
+
+} /* namespace noumenon */
@@ -0,0 +1,74 @@
+/*
+ * Noumenon: A dynamic, strongly typed script language.
+ * Copyright (C) 2015 Tim Wiederhake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef OUTPUT_H_
+#define OUTPUT_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace noumenon {
+
+/*
+ * What scripts print. Text and numbers are formatted into a buffer, which is
+ * written when it is full, and at the end of every line if it is line buffered.
+ * By default only a terminal is line buffered, pipes and files are not.
+ * Anything else that writes to stdout or stderr has to flush it first, so that
+ * the output stays in order.
+ */
+class Output {
+public:
+    enum class Buffering {
+        AUTOMATIC,  /* line buffered for a terminal, block buffered otherwise */
+        LINE,
+        BLOCK
+    };
+
+    /* stdout */
+    static Output standard;
+
+    explicit Output(const int& descriptor);
+    ~Output();
+
+    void setBuffering(const Buffering&);
+
+    void write(const char*, const std::size_t&);
+    void write(const std::string&);
+    void write(const char&);
+    void write(const signed long long&);
+
+    /* formatted as std::ostream does by default */
+    void write(const double&);
+
+    /* ends the line */
+    void line();
+    void flush();
+
+private:
+    static const std::size_t capacity = 65536;
+
+    int descriptor;
+    bool lineBuffered;
+    std::unique_ptr<char[]> buffer;
+    std::size_t used;
+};
+
+} /* namespace noumenon */
+
+#endif /* OUTPUT_H_ */
@@ -17,11 +17,22 @@
  */
 
 #include "Program.h"
+#include "Compiler.h"
+#include "Jit.h"
+#include "Machine.h"
+#include "Modules.h"
+#include "Optimizer.h"
+#include "Output.h"
+#include "Utf8.h"
 #include "Value.h"
 
 #include <iostream>
 #include <fstream>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 using namespace std;
 
 namespace noumenon {
@@ -209,19 +220,113 @@ static const char* token_name(const Token& token) {
     return "UNKNOWN TOKEN";
 }
 
+/*
+ * Keywords, by a perfect hash of their second character and their length. No
+ * two keywords share a bucket, so an identifier is compared to one keyword at
+ * most.
+ */
+struct Keyword {
+    u32string word;
+    Token token;
+};
+
+static const Keyword keywords[16] = {
+    {U"", TOKEN_IDENTIFIER},
+    {U"for", KEYWORD_FOR},
+    {U"if", KEYWORD_IF},
+    {U"var", KEYWORD_VAR},
+    {U"else", KEYWORD_ELSE},
+    {U"function", KEYWORD_FUNCTION},
+    {U"while", KEYWORD_WHILE},
+    {U"", TOKEN_IDENTIFIER},
+    {U"", TOKEN_IDENTIFIER},
+    {U"return", KEYWORD_RETURN},
+    {U"true", KEYWORD_TRUE},
+    {U"", TOKEN_IDENTIFIER},
+    {U"", TOKEN_IDENTIFIER},
+    {U"null", KEYWORD_NULL},
+    {U"", TOKEN_IDENTIFIER},
+    {U"false", KEYWORD_FALSE}
+};
+
+static Token keyword(const u32string& identifier) {
+    if (identifier.size() < 2) {
+        return TOKEN_IDENTIFIER;
+    }
+
+    const auto& candidate = keywords[(identifier[1] + 6 * identifier.size()) % 16];
+    return candidate.word == identifier ? candidate.token : TOKEN_IDENTIFIER;
+}
+
+/* number of leading bytes that are spaces, sixteen at a time */
+static size_t spaces(const char* begin, const char* end) {
+    size_t result = 0;
+#ifdef __SSE2__
+    const auto space = _mm_set1_epi8(' ');
+    while (end - begin - result >= 16) {
+        const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin + result));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, space)) != 0xffff) {
+            break;
+        }
+        result += 16;
+    }
+#else
+    (void) begin;
+    (void) end;
+#endif
+    return result;
+}
+
+/*
+ * number of leading bytes that are printable ASCII other than the given one,
+ * sixteen at a time: the body of a comment up to the next line break or
+ * character that may end it
+ */
+static size_t plain(const char* begin, const char* end, const char& excluded) {
+    size_t result = 0;
+#ifdef __SSE2__
+    const auto control = _mm_set1_epi8(0x1f);
+    const auto other = _mm_set1_epi8(excluded);
+    while (end - begin - result >= 16) {
+        const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin + result));
+        const auto printable = _mm_andnot_si128(_mm_cmpeq_epi8(bytes, other), _mm_cmpgt_epi8(bytes, control));
+        if (_mm_movemask_epi8(printable) != 0xffff) {
+            break;
+        }
+        result += 16;
+    }
+#else
+    (void) begin;
+    (void) end;
+    (void) excluded;
+#endif
+    return result;
+}
+
+/*
+ * Splits source code into tokens. The lexer works on a buffer: either the
+ * whole text, e.g. a file mapped into memory, or the bytes read from a stream
+ * so far, which is read no further than needed as it may be interactive.
+ */
 class Lexer {
 public:
-    Lexer(istream& stream) : currentRow(1), currentCol(0), currentIdentifier(), currentChar(' '), stream(stream) {
+    Lexer(istream& stream) : currentRow(1), currentCol(0), currentIdentifier(), currentAtom(), currentChar(' '), stream(&stream), buffer(), position(buffer.data()), end(position), finished(false) {
+    }
+
+    Lexer(const char* text, const size_t& size) : currentRow(1), currentCol(0), currentIdentifier(), currentAtom(), currentChar(' '), stream(nullptr), buffer(), position(text), end(text + size), finished(false) {
     }
 
     Token operator()() {
         /* remove whitespace */
         while (is_whitespace(currentChar)) {
+            if (currentChar == ' ') {
+                skip(spaces(position, end));
+            }
             getChar();
         }
 
         /* end of file */
-        if (stream.eof()) {
+        if (finished) {
             return TOKEN_EOF;
         }
 
@@ -232,29 +337,11 @@ public:
                 getChar();
             }
 
-            if (currentIdentifier == U"else") {
-                return KEYWORD_ELSE;
-            } else if (currentIdentifier == U"false") {
-                return KEYWORD_FALSE;
-            } else if (currentIdentifier == U"for") {
-                return KEYWORD_FOR;
-            } else if (currentIdentifier == U"function") {
-                return KEYWORD_FUNCTION;
-            } else if (currentIdentifier == U"if") {
-                return KEYWORD_IF;
-            } else if (currentIdentifier == U"null") {
-                return KEYWORD_NULL;
-            } else if (currentIdentifier == U"return") {
-                return KEYWORD_RETURN;
-            } else if (currentIdentifier == U"true") {
-                return KEYWORD_TRUE;
-            } else if (currentIdentifier == U"var") {
-                return KEYWORD_VAR;
-            } else if (currentIdentifier == U"while") {
-                return KEYWORD_WHILE;
+            const auto token = keyword(currentIdentifier);
+            if (token == TOKEN_IDENTIFIER) {
+                currentAtom = currentIdentifier;
             }
-
-            return TOKEN_IDENTIFIER;
+            return token;
         }
 
         if (currentChar == '\"') {
@@ -312,7 +399,8 @@ public:
         case '/': {
             if (currentChar == '/') {
                 /* single line comment */
-                while (!stream.eof() && currentChar != '\n' && currentChar != '\r') {
+                while (!finished && currentChar != '\n' && currentChar != '\r') {
+                    skip(plain(position, end, '\n'));
                     getChar();
                 }
 
@@ -321,7 +409,8 @@ public:
 
             if (currentChar == '*') {
                 /* multi line comment */
-                while (!stream.eof()) {
+                while (!finished) {
+                    skip(plain(position, end, '*'));
                     getChar();
 
                     if (currentChar != '*') {
@@ -394,42 +483,68 @@ public:
     unsigned currentCol;
     u32string currentIdentifier;
 
+    /* the current identifier, interned */
+    Atom currentAtom;
+
 private:
+    /* makes the given number of bytes available, unless the input ends before */
+    bool available(const size_t& count) {
+        if ((size_t) (end - position) >= count) {
+            return true;
+        }
+
+        if (stream == nullptr) {
+            return false;
+        }
+
+        buffer.erase(0, position - buffer.data());
+        while (buffer.size() < count) {
+            const auto next = stream->get();
+            if (next == char_traits<char>::eof()) {
+                break;
+            }
+            buffer += (char) next;
+        }
+
+        position = buffer.data();
+        end = position + buffer.size();
+        return buffer.size() >= count;
+    }
+
+    /* steps over bytes known to be ASCII characters other than line breaks */
+    void skip(const size_t& count) {
+        position += count;
+        currentCol += count;
+    }
+
     void getChar() {
         currentCol += 1;
 
-        const auto next_char = stream.get();
+        if (!available(1)) {
+            finished = true;
+            currentChar = char_traits<char32_t>::eof();
+            return;
+        }
 
-        if (next_char == '\n' || next_char == '\r') {
+        const unsigned char next = *position;
+        if (next == '\n' || next == '\r') {
             /* newline */
             currentRow += 1;
             currentCol = 0;
         }
 
-        if(next_char < 0x80) {
+        if (next < 0x80) {
             /* ascii character */
-            currentChar = next_char;
+            currentChar = next;
+            position += 1;
             return;
         }
 
-        /* unicode character */
-        string mbs;
-        mbs += next_char;
-
-
-        auto length = 4;
-        if (next_char < 0xf0) {
-            length = 3;
-        }
-        if (next_char < 0xe0) {
-            length = 2;
-        }
-
-        while(--length > 0) {
-            mbs += stream.get();
-        }
-
-        currentChar = StringValue::UTF8toUTF32(mbs)[0];
+        /* unicode character, the lead byte tells the length of the sequence */
+        available(next < 0xe0 ? 2 : next < 0xf0 ? 3 : 4);
+        size_t length;
+        currentChar = Utf8::decode(position, end - position, length);
+        position += length;
     }
 
     Token parseFloat() {
@@ -489,7 +604,7 @@ private:
         while (currentChar != '\"') {
 
             /* premature EOF? */
-            if (stream.eof()) {
+            if (finished) {
                 return TOKEN_UNKNOWN;
             }
 
@@ -554,7 +669,14 @@ private:
     }
 
     char32_t currentChar;
-    istream& stream;
+    istream* stream;
+
+    /* bytes read from the stream and not yet consumed */
+    string buffer;
+
+    const char* position;
+    const char* end;
+    bool finished;
 };
 
 class Parser {
@@ -589,8 +711,8 @@ private:
         throw to_string(lexer.currentRow) + ":" + to_string(lexer.currentCol) + ": " + message;
     }
 
-    u32string parseIdentifier() {
-        u32string identifier = lexer.currentIdentifier;
+    Atom parseIdentifier() {
+        const auto identifier = lexer.currentAtom;
         eat(TOKEN_IDENTIFIER);
         return identifier;
     }
@@ -783,7 +905,7 @@ private:
             auto value = make_shared<ObjectExpression>();
             eat(BRACKET_CURLY_LEFT);
             if (currentToken != BRACKET_CURLY_RIGHT) {
-                std::u32string key = parseIdentifier();
+                auto key = parseIdentifier();
                 eat(TOKEN_COLON);
                 auto expr = parseExpression();
                 value->values[key] = expr;
@@ -898,6 +1020,14 @@ private:
         node->expression = parseExpression();
         eat(TOKEN_SEMICOLON);
 
+        auto binary = dynamic_pointer_cast<BinaryExpression>(node->expression);
+        if (binary && binary->oper == BinaryOperator::ADD && variable->expressions.empty()) {
+            auto lhs = dynamic_pointer_cast<VariableExpression>(binary->lhs);
+            if (lhs && lhs->expressions.empty() && lhs->identifier == variable->identifier) {
+                node->append = binary;
+            }
+        }
+
         return node;
     }
 
@@ -936,7 +1066,7 @@ private:
             node->value = parseIdentifier();
         } else {
             node->value = node->key;
-            node->key = U"";
+            node->key = Atom();
         }
 
         eat(TOKEN_COLON);
@@ -993,6 +1123,7 @@ private:
 
         eat(KEYWORD_RETURN);
         node->expression = parseExpression();
+        node->tailCall = dynamic_pointer_cast<CallExpression>(node->expression);
         eat(TOKEN_SEMICOLON);
 
         return node;
@@ -1029,225 +1160,544 @@ private:
     }
 };
 
-shared_ptr<Value> Program::execute(Program& program, istream& stream) {
+Datum Program::execute(Program& program, istream& stream) {
     noumenon::Lexer lexer(stream);
+    return execute(program, lexer, nullptr);
+}
+
+Datum Program::execute(Program& program, const string& path, const char* text, const size_t& size, Cache::Writer* writer) {
+    const auto cache = program.getRoot()->cache.get();
+    if (cache == nullptr) {
+        noumenon::Lexer lexer(text, size);
+        return execute(program, lexer, writer);
+    }
+
+    Cache::Writer ownWriter;
+    if (writer == nullptr) {
+        writer = &ownWriter;
+    }
+
+    vector<shared_ptr<Statement>> statements;
+    if (cache->load(path, text, size, statements)) {
+        for (auto& statement : statements) {
+            writer->add(*statement);
+            program.getModules().prefetch(*statement, cache);
+        }
+        writer->finish();
+        return execute(program, statements);
+    }
+
+    noumenon::Lexer lexer(text, size);
+    const auto& returnValue = execute(program, lexer, writer);
+    cache->store(path, text, size, *writer);
+    return returnValue;
+}
+
+Datum Program::execute(Program& program, const vector<shared_ptr<Statement>>& statements) {
+    for (auto& statement : statements) {
+        const auto& returnValue = execute(program, statement);
+        if (!returnValue.isEmpty()) {
+            return returnValue;
+        }
+    }
+    return make_shared<ObjectValue>();
+}
+
+vector<shared_ptr<Statement>> Program::parse(const string& path, const char* text, const size_t& size, const Cache* cache, Cache::Writer& writer) {
+    vector<shared_ptr<Statement>> statements;
+    if (cache != nullptr && cache->load(path, text, size, statements)) {
+        for (auto& statement : statements) {
+            writer.add(*statement);
+        }
+        writer.finish();
+        return statements;
+    }
+
+    noumenon::Lexer lexer(text, size);
+    noumenon::Parser parser(lexer);
+    shared_ptr<noumenon::Statement> statement;
+    while ((statement = parser())) {
+        writer.add(*statement);
+        statements.push_back(statement);
+    }
+    writer.finish();
+
+    if (cache != nullptr) {
+        cache->store(path, text, size, writer);
+    }
+    return statements;
+}
+
+Datum Program::execute(Program& program, Lexer& lexer, Cache::Writer* writer) {
     noumenon::Parser parser(lexer);
+    auto& modules = program.getModules();
+    const auto cache = program.getRoot()->cache.get();
 
     shared_ptr<noumenon::Statement> statement;
     while (true) {
         if (!(statement = parser())) {
+            if (writer != nullptr) {
+                writer->finish();
+            }
             return make_shared<ObjectValue>();
         }
 
-        const auto& returnValue = statement->walk(program);
-        if (returnValue != nullptr) {
-            return returnValue;
+        /* the cache gets the statement as parsed, before it is resolved and optimized */
+        if (writer != nullptr) {
+            writer->add(*statement);
+        }
+
+        /* the scripts it requires are parsed while it runs */
+        modules.prefetch(*statement, cache);
+
+        const auto& returnValue = execute(program, statement);
+        if (returnValue.isEmpty()) {
+            continue;
+        }
+
+        /* the rest of the script is not run, but the cache has to hold all of it */
+        if (writer != nullptr) {
+            try {
+                while ((statement = parser())) {
+                    writer->add(*statement);
+                }
+                writer->finish();
+            } catch (const string&) {
+                /* not cached, the error shows only if the statement before it does not return */
+            }
+        }
+        return returnValue;
+    }
+}
+
+Datum Program::execute(Program& program, shared_ptr<Statement> statement) {
+    Resolver::resolve(*statement);
+    const auto& statements = program.getRoot()->optimizer->optimize(statement, program);
+
+    if (program.engine == Engine::MACHINE) {
+        const auto& chunk = Compiler::compile({}, statements, nullptr);
+        Machine machine(program, *chunk);
+        return machine();
+    }
+    return program.run(statements);
+}
+
+Arena::Arena() : blocks(), block(0), offset(0) {
+}
+
+Arena::Mark Arena::top() const {
+    return {block, offset};
+}
+
+Datum* Arena::allocate(const unsigned& count) {
+    if (blocks.empty() || offset + count > blocks[block].size) {
+        if (!blocks.empty()) {
+            block += 1;
+        }
+        if (block == blocks.size() || blocks[block].size < count) {
+            const auto size = count > blockSize ? count : blockSize;
+            blocks.insert(blocks.begin() + block, {unique_ptr<Datum[]>(new Datum[size]), size});
         }
+        offset = 0;
     }
+
+    auto result = &blocks[block].slots[offset];
+    offset += count;
+    return result;
+}
+
+void Arena::release(const Mark& mark) {
+    /* slots are released in reverse order, so only one block can be left */
+    if (block != mark.block) {
+        for (unsigned i = 0; i < offset; ++i) {
+            blocks[block].slots[i] = nullptr;
+        }
+        block = mark.block;
+        offset = mark.offset;
+        return;
+    }
+
+    for (auto i = mark.offset; i < offset; ++i) {
+        blocks[block].slots[i] = nullptr;
+    }
+    offset = mark.offset;
+}
+
+Program::Program(const bool& quiet, const Engine& engine, const bool& jit) : quiet(quiet), jit(jit), engine(engine), parent(nullptr), values(), ownArena(new Arena()), arena(ownArena.get()), optimizer(new Optimizer()), cache(), modules(new ModuleRegistry()), layout(nullptr), slots(nullptr), mark(), frame(nullptr) {
 }
 
-Program::Program(const bool& quiet) : quiet(quiet), parent(nullptr) {
+Program::Program(Program& parent) : quiet(parent.quiet), jit(parent.jit), engine(parent.engine), parent(&parent), values(), ownArena(), arena(parent.arena), optimizer(), cache(), modules(), layout(nullptr), slots(nullptr), mark(), frame(nullptr) {
 }
 
-Program::Program(Program& parent) : ObjectValue(), quiet(parent.quiet), parent(&parent) {
+Program::Program(Program& parent, const Layout& layout) : quiet(parent.quiet), jit(parent.jit), engine(parent.engine), parent(&parent), values(), ownArena(), arena(parent.arena), optimizer(), cache(), modules(), layout(nullptr), slots(nullptr), mark(), frame(nullptr) {
+    enter(layout);
 }
 
 Program::~Program() {
+    if (slots != nullptr) {
+        arena->release(mark);
+    }
 }
 
-std::shared_ptr<Value> Program::statement(AssignmentStatement& node) {
+Datum Program::statement(AssignmentStatement& node) {
+    if (node.append) {
+        const auto lhs = node.append->lhs->walk(*this);
+        const auto rhs = node.append->rhs->walk(*this);
+        if (!appendVariable(node.variable->address, node.variable->identifier, lhs, rhs)) {
+            writeVariable(*node.variable, binary(*node.append, lhs, rhs));
+        }
+        return nullptr;
+    }
+
     writeVariable(*node.variable, node.expression->walk(*this));
     return nullptr;
 }
 
-std::shared_ptr<Value> Program::statement(CallStatement& node) {
-    vector<shared_ptr<Value>> parameters;
+Datum Program::statement(CallStatement& node) {
+    vector<Datum> parameters;
     for (auto& expression : node.expressions) {
         parameters.push_back(expression->walk(*this));
     }
 
     Program subscope(*this);
-    node.function->walk(*this)->doCall(subscope, parameters);
+    node.function->walk(*this).doCall(subscope, parameters);
     return nullptr;
 }
 
-std::shared_ptr<Value> Program::statement(ForStatement& node) {
-    auto value = node.expression->walk(*this);
+Datum Program::statement(ForStatement& node) {
+    const auto value = node.expression->walk(*this);
 
-    for (unsigned long long i = 0; i < value->getLength(); ++i) {
-        Program subscope(*this);
-        if (!node.key.empty()) {
-            subscope.insertVariable(node.key, value->getKey(i));
-        }
-        subscope.insertVariable(node.value, value->getValue(i));
+    /* every iteration starts over in the same scope, with its slots cleared */
+    Program subscope(*this);
+
+    /* a range is counted through, its numbers are never boxed */
+    const auto range = value.getTag() == Datum::Tag::BOXED ? dynamic_cast<RangeValue*>(value.getBoxed().get()) : nullptr;
+    if (range != nullptr) {
+        for (unsigned long long index = 0; index < range->count; ++index) {
+            subscope.enter(*node.layout);
+            if (!node.key.empty()) {
+                subscope.defineVariable(node.keyAddress, node.key, Datum((signed long long) index));
+            }
+            subscope.defineVariable(node.valueAddress, node.value, Datum(range->at(index)));
 
-        for (auto& statement : node.statements) {
-            const auto& returnValue = statement->walk(subscope);
-            if (returnValue != nullptr) {
+            const auto& returnValue = subscope.run(node.statements);
+            if (!returnValue.isEmpty()) {
                 return returnValue;
             }
         }
+        return nullptr;
     }
-    return nullptr;
-}
 
-std::shared_ptr<Value> Program::statement(IfStatement& node) {
-    auto condition = node.condition->walk(*this);
-    Program body(*this);
-    if (condition->isTrue()) {
-        for (auto& statement : node.statementsThen) {
-            const auto& returnValue = statement->walk(body);
-            if (returnValue != nullptr) {
-                return returnValue;
-            }
+    for (auto cursor = value.iterate(); cursor->next();) {
+        subscope.enter(*node.layout);
+        if (!node.key.empty()) {
+            subscope.defineVariable(node.keyAddress, node.key, cursor->getKey());
         }
-    } else {
-        for (auto& statement : node.statementsElse) {
-            const auto& returnValue = statement->walk(body);
-            if (returnValue != nullptr) {
-                return returnValue;
-            }
+        subscope.defineVariable(node.valueAddress, node.value, cursor->getValue());
+
+        const auto& returnValue = subscope.run(node.statements);
+        if (!returnValue.isEmpty()) {
+            return returnValue;
         }
     }
     return nullptr;
 }
 
-std::shared_ptr<Value> Program::statement(ReturnStatement& node) {
-    return node.expression->walk(*this);
+Datum Program::statement(IfStatement& node) {
+    auto condition = node.condition->walk(*this);
+    if (condition.isTrue()) {
+        return block(node.statementsThen, node.layoutThen.get());
+    }
+    return block(node.statementsElse, node.layoutElse.get());
 }
 
-std::shared_ptr<Value> Program::statement(VarStatement& node) {
-    insertVariable(node.identifier, node.expression->walk(*this));
+Datum Program::statement(ReturnStatement& node) {
+    if (!node.tailCall || frame == nullptr) {
+        return node.expression->walk(*this);
+    }
+
+    vector<Datum> expressions;
+    for (auto& expression : node.tailCall->expressions) {
+        expressions.push_back(expression->walk(*this));
+    }
+
+    const auto function = node.tailCall->function->walk(*this);
+    if (tailCall(function, expressions)) {
+        return NullValue::singleton;
+    }
+
+    Program subscope(*this);
+    return function.doCall(subscope, expressions);
+}
+
+Datum Program::statement(VarStatement& node) {
+    defineVariable(node.address, node.identifier, node.expression->walk(*this));
     return nullptr;
 }
 
-std::shared_ptr<Value> Program::statement(WhileStatement& node) {
-    while (node.condition->walk(*this)->isTrue()) {
-        Program body(*this);
-        for (auto& statement : node.statements) {
-            const auto& returnValue = statement->walk(body);
-            if (returnValue) {
-                return returnValue;
+Datum Program::statement(WhileStatement& node) {
+    for (unsigned iteration = 1;; ++iteration) {
+        /* a long running loop continues in native code, which starts with the condition */
+        if (jit && iteration == Jit::threshold) {
+            if (!node.chunk) {
+                node.chunk = Compiler::compile(node);
+                node.chunk->native = Jit::compile(*node.chunk);
             }
+
+            if (node.chunk->native) {
+                Machine machine(*this, *node.chunk);
+                return machine();
+            }
+        }
+
+        if (!node.condition->walk(*this).isTrue()) {
+            return nullptr;
+        }
+
+        const auto& returnValue = block(node.statements, node.layout.get());
+        if (!returnValue.isEmpty()) {
+            return returnValue;
         }
     }
-    return nullptr;
 }
 
-shared_ptr<Value> Program::expression(ArrayExpression& node) {
-    vector<shared_ptr<Value>> values;
+Datum Program::expression(ArrayExpression& node) {
+    vector<Datum> values;
     for (auto& expression : node.expressions) {
         values.push_back(expression->walk(*this));
     }
     return make_shared<ArrayValue>(values);
 }
 
-shared_ptr<Value> Program::expression(BinaryExpression& node) {
-    return node.lhs->walk(*this)->doBinary(node.oper, node.rhs->walk(*this));
+Datum Program::expression(BinaryExpression& node) {
+    const auto lhs = node.lhs->walk(*this);
+    const auto rhs = node.rhs->walk(*this);
+    return binary(node, lhs, rhs);
 }
 
-shared_ptr<Value> Program::expression(BoolExpression& node) {
-    return make_shared<BoolValue>(node.value);
+Datum Program::binary(BinaryExpression& node, const Datum& lhs, const Datum& rhs) {
+    switch (node.specialization) {
+    case Specialization::BOOL:
+        if (lhs.getTag() == Datum::Tag::BOOL && rhs.getTag() == Datum::Tag::BOOL) {
+            return Datum::binaryBool(node.oper, lhs.getBool(), rhs.getBool());
+        }
+        break;
+
+    case Specialization::INT:
+        if (lhs.getTag() == Datum::Tag::INT && rhs.getTag() == Datum::Tag::INT) {
+            return Datum::binaryInt(node.oper, lhs.getInt(), rhs.getInt());
+        }
+        break;
+
+    case Specialization::FLOAT:
+        if (lhs.getTag() == Datum::Tag::FLOAT && rhs.getTag() == Datum::Tag::FLOAT) {
+            return Datum::binaryFloat(node.oper, lhs.getFloat(), rhs.getFloat(), false);
+        }
+        break;
+
+    case Specialization::NONE:
+        node.specialization = specialize(lhs, rhs);
+        return lhs.doBinary(node.oper, rhs);
+
+    case Specialization::GENERIC:
+        return lhs.doBinary(node.oper, rhs);
+    }
+
+    /* the guard failed */
+    node.specialization = Specialization::GENERIC;
+    return lhs.doBinary(node.oper, rhs);
+}
+
+Datum Program::expression(BoolExpression& node) {
+    return Datum(node.value);
 }
 
-shared_ptr<Value> Program::expression(CallExpression& node) {
-    vector<shared_ptr<Value>> expressions;
+Datum Program::expression(CallExpression& node) {
+    vector<Datum> expressions;
     for (auto& expression : node.expressions) {
         expressions.push_back(expression->walk(*this));
     }
 
     Program subscope(*this);
-    return node.function->walk(subscope)->doCall(subscope, expressions);
+    return node.function->walk(*this).doCall(subscope, expressions);
 }
 
-shared_ptr<Value> Program::expression(FloatExpression& node) {
-    return make_shared<FloatValue>(node.value);
+Datum Program::expression(FloatExpression& node) {
+    return Datum(node.value);
 }
 
-shared_ptr<Value> Program::expression(FunctionExpression& node) {
-    return make_shared<FunctionValue>(node.parameters, node.statements);
+Datum Program::expression(FunctionExpression& node) {
+    auto function = make_shared<FunctionValue>(node.parameters, node.statements);
+    function->layout = node.layout;
+    return function;
 }
 
-shared_ptr<Value> Program::expression(IntExpression& node) {
-    return make_shared<IntValue>(node.value);
+Datum Program::expression(IntExpression& node) {
+    return Datum(node.value);
 }
 
-shared_ptr<Value> Program::expression(NullExpression&) {
+Datum Program::expression(NullExpression&) {
     return NullValue::singleton;
 }
 
-shared_ptr<Value> Program::expression(ObjectExpression& node) {
-    map<u32string, shared_ptr<Value>> values;
+Datum Program::expression(ObjectExpression& node) {
+    if (node.shape == nullptr) {
+        vector<u32string> keys;
+        for (auto& pair : node.values) {
+            keys.push_back(pair.first);
+        }
+        node.shape = Shape::of(keys);
+    }
+
+    vector<Datum> values;
     for (auto& pair : node.values) {
-        values[pair.first] = pair.second->walk(*this);
+        values.push_back(pair.second->walk(*this));
     }
-    return make_shared<ObjectValue>(values);
+    return make_shared<ObjectValue>(node.shape, std::move(values));
 }
 
-shared_ptr<Value> Program::expression(StringExpression& node) {
-    return make_shared<StringValue>(node.value);
+Datum Program::expression(StringExpression& node) {
+    if (!node.constant) {
+        node.constant = make_shared<StringValue>(node.value);
+    }
+    return node.constant;
 }
 
-shared_ptr<Value> Program::expression(UnaryExpression& node) {
-    return node.rhs->walk(*this)->doUnary(node.oper);
+Datum Program::expression(UnaryExpression& node) {
+    const auto rhs = node.rhs->walk(*this);
+
+    switch (node.specialization) {
+    case Specialization::BOOL:
+        if (rhs.getTag() == Datum::Tag::BOOL) {
+            return Datum::unaryBool(node.oper, rhs.getBool());
+        }
+        break;
+
+    case Specialization::INT:
+        if (rhs.getTag() == Datum::Tag::INT) {
+            return Datum::unaryInt(node.oper, rhs.getInt());
+        }
+        break;
+
+    case Specialization::FLOAT:
+        if (rhs.getTag() == Datum::Tag::FLOAT) {
+            return Datum::unaryFloat(node.oper, rhs.getFloat());
+        }
+        break;
+
+    case Specialization::NONE:
+        node.specialization = specialize(rhs);
+        return rhs.doUnary(node.oper);
+
+    case Specialization::GENERIC:
+        return rhs.doUnary(node.oper);
+    }
+
+    node.specialization = Specialization::GENERIC;
+    return rhs.doUnary(node.oper);
 }
 
-shared_ptr<Value> Program::expression(VariableExpression& node) {
+Datum Program::expression(VariableExpression& node) {
     return readVariable(node);
 }
 
-shared_ptr<Value> Program::readVariable(VariableExpression& variable) {
-    for (Program* scope = this; scope != nullptr; scope = scope->parent) {
-        auto iterator = scope->values.find(variable.identifier);
+Datum Program::readVariable(VariableExpression& variable) {
+    auto binding = locateVariable(variable.address, variable.identifier);
+    if (binding == nullptr) {
+        unknownVariable(variable.identifier);
+        return NullValue::singleton;
+    }
 
-        if (iterator == scope->values.end()) {
-            continue;
-        }
+    auto result = *binding;
+    for (decltype(variable.expressions.size()) i = 0; i < variable.expressions.size(); ++i) {
+        result = select(result, variable, i);
+    }
 
-        auto result = iterator->second;
-        for (auto& selector : variable.expressions) {
-            result = result->doSelect(selector->walk(*this));
-        }
+    return result;
+}
 
-        return result;
+Datum Program::readVariable(const Address& address, const Atom& identifier) {
+    auto binding = locateVariable(address, identifier);
+    if (binding == nullptr) {
+        unknownVariable(identifier);
+        return NullValue::singleton;
     }
 
-    if (!quiet) {
-        cerr << "no such variable: \"" + StringValue::UTF32toUTF8(variable.identifier) + "\"" << endl;
+    return *binding;
+}
+
+void Program::writeVariable(VariableExpression& variable, const Datum& value) {
+    auto binding = locateVariable(variable.address, variable.identifier);
+    if (binding == nullptr) {
+        unknownVariable(variable.identifier);
+        return;
     }
-    return NullValue::singleton;
+
+    if (variable.expressions.empty()) {
+        *binding = value;
+        return;
+    }
+
+    auto result = *binding;
+    const auto last = variable.expressions.size() - 1;
+    for (decltype(variable.expressions.size()) i = 0; i < last; ++i) {
+        result = select(result, variable, i);
+    }
+
+    if (last < variable.caches.size() && variable.caches[last]) {
+        result.doModify(*variable.caches[last], value);
+        return;
+    }
+
+    result.doModify(variable.expressions[last]->walk(*this), value);
 }
 
-void Program::writeVariable(VariableExpression& variable, shared_ptr<Value> value) {
-    for (Program* scope = this; scope != nullptr; scope = scope->parent) {
-        auto iterator = scope->values.find(variable.identifier);
+void Program::writeVariable(const Address& address, const Atom& identifier, const Datum& value) {
+    auto binding = locateVariable(address, identifier);
+    if (binding == nullptr) {
+        unknownVariable(identifier);
+        return;
+    }
 
-        if (iterator == scope->values.end()) {
-            continue;
-        }
+    *binding = value;
+}
 
-        if (variable.expressions.empty()) {
-            iterator->second = value;
-            return;
-        }
+bool Program::appendVariable(const Address& address, const Atom& identifier, const Datum& array, const Datum& value) {
+    if (array.getTag() != Datum::Tag::BOXED || array.getType() != Type::ARRAY) {
+        return false;
+    }
 
-        auto result = iterator->second;
-        for (auto& expression : vector<shared_ptr<Expression>>(variable.expressions.begin(), variable.expressions.end() - 1)) {
-            result = result->doSelect(expression->walk(*this));
-        }
+    /* the variable and the given copy must be the only references, anything else sees the array unchanged */
+    const auto binding = locateVariable(address, identifier);
+    if (binding == nullptr || binding->getTag() != Datum::Tag::BOXED || binding->getBoxed() != array.getBoxed() || array.getBoxed().use_count() != 2) {
+        return false;
+    }
 
-        result->doModify(variable.expressions.back()->walk(*this), value);
+    return static_cast<ArrayValue&>(*array.getBoxed()).doAppend(value);
+}
+
+void Program::defineVariable(const Address& address, const Atom& identifier, const Datum& value) {
+    if (!address.resolved) {
+        insertVariable(identifier, value);
         return;
     }
 
-    if (!quiet) {
-        cerr << "no such variable: \"" + StringValue::UTF32toUTF8(variable.identifier) + "\"" << endl;
+    auto& slot = slots[address.slot];
+    if (!slot.isEmpty()) {
+        if (!quiet) {
+            Output::standard.flush();
+            cerr << "redefinition of variable: \"" + StringValue::UTF32toUTF8(identifier) + "\"" << endl;
+        }
+        return;
     }
+
+    slot = value;
 }
 
-void Program::insertVariable(const u32string& identifier, shared_ptr<Value> value) {
+void Program::insertVariable(const Atom& identifier, const Datum& value) {
     if (values.find(identifier) != values.end()) {
         if (!quiet) {
+            Output::standard.flush();
             cerr << "redefinition of variable: \"" + StringValue::UTF32toUTF8(identifier) + "\"" << endl;
         }
         return;
@@ -1256,8 +1706,168 @@ void Program::insertVariable(const u32string& identifier, shared_ptr<Value> valu
     values[identifier] = value;
 }
 
+bool Program::hasVariable(const Atom& identifier) {
+    return values.find(identifier) != values.end();
+}
+
+map<u32string, Datum> Program::getVariables() {
+    map<u32string, Datum> result(values.begin(), values.end());
+    for (decltype(layout->names.size()) i = 0; slots != nullptr && i < layout->names.size(); ++i) {
+        if (!slots[i].isEmpty()) {
+            result[layout->names[i]] = slots[i];
+        }
+    }
+    return result;
+}
+
 Program* Program::getParent() {
     return parent;
 }
 
+Program* Program::getRoot() {
+    auto root = this;
+    while (root->parent != nullptr) {
+        root = root->parent;
+    }
+    return root;
+}
+
+void Program::useCache(const string& directory) {
+    getRoot()->cache.reset(new Cache(directory));
+}
+
+bool Program::isJit() const {
+    return jit;
+}
+
+ModuleRegistry& Program::getModules() {
+    return *getRoot()->modules;
+}
+
+void Program::enter(const Layout& layout, Frame* frame) {
+    if (slots != nullptr) {
+        arena->release(mark);
+        slots = nullptr;
+    }
+
+    this->layout = &layout;
+    if (!layout.names.empty()) {
+        mark = arena->top();
+        slots = arena->allocate(layout.names.size());
+    }
+    this->frame = frame;
+}
+
+bool Program::tailCall(const Datum& function, vector<Datum>& arguments) {
+    if (frame == nullptr || function.getTag() != Datum::Tag::BOXED || function.getBoxed().get() != &frame->function) {
+        return false;
+    }
+
+    frame->arguments = move(arguments);
+    frame->pending = true;
+    return true;
+}
+
+Datum Program::run(const vector<shared_ptr<Statement>>& statements) {
+    for (auto& statement : statements) {
+        const auto& returnValue = statement->walk(*this);
+        if (!returnValue.isEmpty()) {
+            return returnValue;
+        }
+    }
+    return nullptr;
+}
+
+Datum Program::block(const vector<shared_ptr<Statement>>& statements, const Layout* layout) {
+    if (layout == nullptr) {
+        return run(statements);
+    }
+
+    Program body(*this, *layout);
+    return body.run(statements);
+}
+
+Specialization Program::specialize(const Datum& lhs, const Datum& rhs) {
+    if (lhs.getTag() != rhs.getTag()) {
+        return Specialization::GENERIC;
+    }
+    return specialize(lhs);
+}
+
+Specialization Program::specialize(const Datum& value) {
+    switch (value.getTag()) {
+    case Datum::Tag::BOOL:
+        return Specialization::BOOL;
+    case Datum::Tag::INT:
+        return Specialization::INT;
+    case Datum::Tag::FLOAT:
+        return Specialization::FLOAT;
+    default:
+        return Specialization::GENERIC;
+    }
+}
+
+Datum Program::select(const Datum& value, VariableExpression& variable, const unsigned& index) {
+    if (index < variable.caches.size() && variable.caches[index]) {
+        return value.doSelect(*variable.caches[index]);
+    }
+
+    return value.doSelect(variable.expressions[index]->walk(*this));
+}
+
+Datum* Program::locateVariable(const Address& address, const Atom& identifier) {
+    Program* scope = this;
+    for (unsigned i = 0; i < address.depth && scope->parent != nullptr; ++i) {
+        scope = scope->parent;
+    }
+
+    if (address.resolved && !scope->slots[address.slot].isEmpty()) {
+        return &scope->slots[address.slot];
+    }
+
+    return scope->findVariable(identifier, address.mask);
+}
+
+Datum* Program::resolveVariable(const Address& address) {
+    if (!address.resolved) {
+        return nullptr;
+    }
+
+    Program* scope = this;
+    for (unsigned i = 0; i < address.depth && scope->parent != nullptr; ++i) {
+        scope = scope->parent;
+    }
+
+    return scope->slots[address.slot].isEmpty() ? nullptr : &scope->slots[address.slot];
+}
+
+Datum* Program::findVariable(const Atom& identifier, const unsigned long long& mask) {
+    for (Program* scope = this; scope != nullptr; scope = scope->parent) {
+        if (scope->layout != nullptr && (scope->layout->mask & mask) != 0) {
+            const auto& names = scope->layout->names;
+            for (decltype(names.size()) i = 0; i < names.size(); ++i) {
+                if (!scope->slots[i].isEmpty() && names[i] == identifier) {
+                    return &scope->slots[i];
+                }
+            }
+        }
+
+        if (!scope->values.empty()) {
+            auto iterator = scope->values.find(identifier);
+            if (iterator != scope->values.end()) {
+                return &iterator->second;
+            }
+        }
+    }
+
+    return nullptr;
+}
+
+void Program::unknownVariable(const Atom& identifier) {
+    if (!quiet) {
+        Output::standard.flush();
+        cerr << "no such variable: \"" + StringValue::UTF32toUTF8(identifier) + "\"" << endl;
+    }
+}
+
 } /* namespace scriptlanguage */
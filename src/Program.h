@@ -19,54 +19,198 @@
 #ifndef PROGRAM_H_
 #define PROGRAM_H_
 
+#include "Cache.h"
 #include "Expression.h"
+#include "Resolver.h"
 #include "Statement.h"
 #include "Value.h"
 
 #include <iosfwd>
+#include <unordered_map>
 
 namespace noumenon {
 
-class Program : public StatementWalker, public ExpressionWalker, public ObjectValue {
+class Lexer;
+class ModuleRegistry;
+class Optimizer;
+
+enum class Engine {
+    WALKER,     /* walk the syntax tree */
+    MACHINE     /* compile to bytecode and run it on the register machine */
+};
+
+/* slots of all nested scopes of a program, allocated and released like a stack */
+class Arena {
+public:
+    struct Mark {
+        unsigned block;
+        unsigned offset;
+    };
+
+    Arena();
+
+    Mark top() const;
+    Datum* allocate(const unsigned&);
+    void release(const Mark&);
+
+private:
+    struct Block {
+        std::unique_ptr<Datum[]> slots;
+        unsigned size;
+    };
+
+    static const unsigned blockSize = 4096;
+
+    std::vector<Block> blocks;
+    unsigned block;
+    unsigned offset;
+};
+
+/*
+ * A function running in a scope. A tail call of the same function does not
+ * nest: the arguments are recorded here, the body returns and the call starts
+ * over in the same scope.
+ */
+struct Frame {
+    FunctionValue& function;
+    std::vector<Datum> arguments;
+    bool pending;
+};
+
+class Program : public StatementWalker, public ExpressionWalker {
 public:
-    static std::shared_ptr<Value> execute(Program&, std::istream&);
+    static Datum execute(Program&, std::istream&);
+
+    /*
+     * execute a script file that is in memory as a whole, parsed from the cache
+     * if there is one; its statements are added to the writer if one is given
+     */
+    static Datum execute(Program&, const std::string& path, const char*, const std::size_t&, Cache::Writer* = nullptr);
+
+    /* execute top level statements that were parsed before, e.g. restored with Cache::Writer::read */
+    static Datum execute(Program&, const std::vector<std::shared_ptr<Statement>>&);
 
-    explicit Program(const bool&);
+    /*
+     * parse a script file without executing it, from the cache if one is given;
+     * the statements are added to the writer as well, syntax errors are thrown
+     */
+    static std::vector<std::shared_ptr<Statement>> parse(const std::string& path, const char*, const std::size_t&, const Cache*, Cache::Writer&);
+
+    explicit Program(const bool&, const Engine& = Engine::WALKER, const bool& jit = false);
     explicit Program(Program& parent);
+    Program(Program& parent, const Layout&);
     ~Program();
 
     /* execute a statement */
-    std::shared_ptr<Value> statement(AssignmentStatement&);
-    std::shared_ptr<Value> statement(CallStatement&);
-    std::shared_ptr<Value> statement(ForStatement&);
-    std::shared_ptr<Value> statement(IfStatement&);
-    std::shared_ptr<Value> statement(ReturnStatement&);
-    std::shared_ptr<Value> statement(VarStatement&);
-    std::shared_ptr<Value> statement(WhileStatement&);
+    Datum statement(AssignmentStatement&);
+    Datum statement(CallStatement&);
+    Datum statement(ForStatement&);
+    Datum statement(IfStatement&);
+    Datum statement(ReturnStatement&);
+    Datum statement(VarStatement&);
+    Datum statement(WhileStatement&);
 
     /* calculate the value of an expression */
-    std::shared_ptr<Value> expression(ArrayExpression&);
-    std::shared_ptr<Value> expression(BinaryExpression&);
-    std::shared_ptr<Value> expression(BoolExpression&);
-    std::shared_ptr<Value> expression(CallExpression&);
-    std::shared_ptr<Value> expression(FloatExpression&);
-    std::shared_ptr<Value> expression(FunctionExpression&);
-    std::shared_ptr<Value> expression(IntExpression&);
-    std::shared_ptr<Value> expression(NullExpression&);
-    std::shared_ptr<Value> expression(ObjectExpression&);
-    std::shared_ptr<Value> expression(StringExpression&);
-    std::shared_ptr<Value> expression(UnaryExpression&);
-    std::shared_ptr<Value> expression(VariableExpression&);
+    Datum expression(ArrayExpression&);
+    Datum expression(BinaryExpression&);
+    Datum expression(BoolExpression&);
+    Datum expression(CallExpression&);
+    Datum expression(FloatExpression&);
+    Datum expression(FunctionExpression&);
+    Datum expression(IntExpression&);
+    Datum expression(NullExpression&);
+    Datum expression(ObjectExpression&);
+    Datum expression(StringExpression&);
+    Datum expression(UnaryExpression&);
+    Datum expression(VariableExpression&);
 
     /* variables defined in this scope */
-    std::shared_ptr<Value> readVariable(VariableExpression&);
-    void writeVariable(VariableExpression&, std::shared_ptr<Value>);
-    void insertVariable(const std::u32string&, std::shared_ptr<Value> value);
+    Datum readVariable(VariableExpression&);
+    Datum readVariable(const Address&, const Atom&);
+    void writeVariable(VariableExpression&, const Datum&);
+    void writeVariable(const Address&, const Atom&, const Datum&);
+    void defineVariable(const Address&, const Atom&, const Datum&);
+
+    /*
+     * appends a value to the array in a variable in place, if nothing but the
+     * variable and the given copy of it refers to the array; returns false if
+     * the array has to be copied as usual
+     */
+    bool appendVariable(const Address&, const Atom&, const Datum& array, const Datum& value);
+
+    /* slot of a resolved variable, nullptr if the variable is not resolved or the slot holds no value */
+    Datum* resolveVariable(const Address&);
+    void insertVariable(const Atom&, const Datum& value);
+    bool hasVariable(const Atom&);
+    std::map<std::u32string, Datum> getVariables();
     Program* getParent();
 
+    /* keep parsed scripts in the given directory, see Cache; applies to the outermost program */
+    void useCache(const std::string& directory);
+    bool isJit() const;
+
+    /* scripts loaded with require() and import(), shared by all scopes of the outermost program */
+    ModuleRegistry& getModules();
+
+    /* give this scope the slots of a function body, tail calls of the function reuse it if a frame is given */
+    void enter(const Layout&, Frame* = nullptr);
+
+    /* records a tail call if the function is the one running in this scope, see Frame */
+    bool tailCall(const Datum&, std::vector<Datum>&);
+
+    /* execute statements in this scope, returns an empty Datum if none returned */
+    Datum run(const std::vector<std::shared_ptr<Statement>>&);
+
 private:
+    static Datum execute(Program&, Lexer&, Cache::Writer*);
+    static Datum execute(Program&, std::shared_ptr<Statement>);
+
+    Program* getRoot();
+    Datum* locateVariable(const Address&, const Atom&);
+    Datum* findVariable(const Atom&, const unsigned long long&);
+    void unknownVariable(const Atom&);
+
+    /* execute statements in a nested scope, unless the block declares no variables */
+    Datum block(const std::vector<std::shared_ptr<Statement>>&, const Layout*);
+
+    /* apply an operator expression to operands evaluated already */
+    Datum binary(BinaryExpression&, const Datum&, const Datum&);
+
+    /* specialization of an operator expression for the types of its first operands */
+    static Specialization specialize(const Datum&, const Datum&);
+    static Specialization specialize(const Datum&);
+
+    /* select from a value with the selector at the given position of a variable expression */
+    Datum select(const Datum&, VariableExpression&, const unsigned&);
+
     bool quiet;
+
+    /* compile hot functions and loops to native code, see Jit */
+    bool jit;
+
+    Engine engine;
+
     Program* parent;
+
+    /* variables that are looked up by name */
+    std::unordered_map<Atom, Datum> values;
+
+    /* the arena is owned by the outermost program */
+    std::unique_ptr<Arena> ownArena;
+    Arena* arena;
+
+    /* only the outermost program has an optimizer, a cache if enabled, and a module registry that may use the cache */
+    std::unique_ptr<Optimizer> optimizer;
+    std::unique_ptr<Cache> cache;
+    std::unique_ptr<ModuleRegistry> modules;
+
+    /* variables declared in nested scopes live in slots */
+    const Layout* layout;
+    Datum* slots;
+    Arena::Mark mark;
+
+    /* set if this is the scope of a function body that tail calls may reuse */
+    Frame* frame;
 };
 
 } /* namespace noumenon */
@@ -0,0 +1,305 @@
+/*
+ * Noumenon: A dynamic, strongly typed script language.
+ * Copyright (C) 2015 Tim Wiederhake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#include "Resolver.h"
+#include "Value.h"
+
+using namespace std;
+
+namespace noumenon {
+
+unsigned long long Layout::maskOf(const Atom& name) {
+    /* one bit out of 64, so scopes can be skipped without comparing names */
+    unsigned long long hash = 14695981039346656037ULL;
+    for (const auto& c : name.str()) {
+        hash = (hash ^ c) * 1099511628211ULL;
+    }
+    return 1ULL << (hash % 64);
+}
+
+unsigned Layout::declare(const Atom& name) {
+    for (decltype(names.size()) i = 0; i < names.size(); ++i) {
+        if (names[i] == name) {
+            return i;
+        }
+    }
+
+    names.push_back(name);
+    mask |= maskOf(name);
+    return names.size() - 1;
+}
+
+void Resolver::resolve(Statement& statement) {
+    Resolver resolver;
+    statement.walk(resolver);
+}
+
+Resolver::Resolver() : levels() {
+}
+
+void Resolver::resolve(const Atom& name, Address& address) {
+    address.depth = 0;
+    address.slot = 0;
+    address.resolved = false;
+    address.mask = Layout::maskOf(name);
+
+    for (auto level = levels.rbegin(); level != levels.rend(); ++level) {
+        const auto& names = level->layout->names;
+        for (decltype(names.size()) i = 0; i < names.size(); ++i) {
+            if (names[i] == name) {
+                address.slot = i;
+                address.resolved = true;
+                return;
+            }
+        }
+
+        address.depth += 1;
+
+        /* beyond this point, the caller's variables are visible */
+        if (level->function) {
+            return;
+        }
+    }
+}
+
+void Resolver::declare(const Atom& name, Address& address) {
+    address.depth = 0;
+    address.slot = 0;
+    address.resolved = false;
+    address.mask = Layout::maskOf(name);
+
+    if (!levels.empty()) {
+        address.slot = levels.back().layout->declare(name);
+        address.resolved = true;
+    }
+
+    for (auto level = levels.rbegin(); level != levels.rend(); ++level) {
+        if (level->function) {
+            level->layout->reusable = false;
+            break;
+        }
+    }
+}
+
+bool Resolver::declares(const vector<shared_ptr<Statement>>& statements) {
+    struct Walker : public StatementWalker {
+        Datum statement(AssignmentStatement&) {
+            return nullptr;
+        }
+
+        Datum statement(CallStatement&) {
+            return nullptr;
+        }
+
+        Datum statement(ForStatement&) {
+            return nullptr;
+        }
+
+        Datum statement(IfStatement&) {
+            return nullptr;
+        }
+
+        Datum statement(ReturnStatement&) {
+            return nullptr;
+        }
+
+        Datum statement(VarStatement&) {
+            return Datum(true);
+        }
+
+        Datum statement(WhileStatement&) {
+            return nullptr;
+        }
+    } walker;
+
+    for (auto& statement : statements) {
+        if (!statement->walk(walker).isEmpty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+shared_ptr<Layout> Resolver::block(const vector<shared_ptr<Statement>>& statements) {
+    /* blocks without variables do not get a scope */
+    if (!declares(statements)) {
+        for (auto& statement : statements) {
+            statement->walk(*this);
+        }
+        return nullptr;
+    }
+
+    auto layout = make_shared<Layout>();
+    layout->mask = 0;
+    layout->reusable = false;
+
+    levels.push_back({layout.get(), false});
+    for (auto& statement : statements) {
+        statement->walk(*this);
+    }
+    levels.pop_back();
+
+    return layout;
+}
+
+Datum Resolver::statement(AssignmentStatement& node) {
+    node.expression->walk(*this);
+    node.variable->walk(*this);
+    return nullptr;
+}
+
+Datum Resolver::statement(CallStatement& node) {
+    for (auto& expression : node.expressions) {
+        expression->walk(*this);
+    }
+    node.function->walk(*this);
+    return nullptr;
+}
+
+Datum Resolver::statement(ForStatement& node) {
+    node.expression->walk(*this);
+
+    node.layout = make_shared<Layout>();
+    node.layout->mask = 0;
+    node.layout->reusable = false;
+
+    levels.push_back({node.layout.get(), false});
+    if (!node.key.empty()) {
+        declare(node.key, node.keyAddress);
+    }
+    declare(node.value, node.valueAddress);
+    for (auto& statement : node.statements) {
+        statement->walk(*this);
+    }
+    levels.pop_back();
+    return nullptr;
+}
+
+Datum Resolver::statement(IfStatement& node) {
+    node.condition->walk(*this);
+    node.layoutThen = block(node.statementsThen);
+    node.layoutElse = block(node.statementsElse);
+    return nullptr;
+}
+
+Datum Resolver::statement(ReturnStatement& node) {
+    node.expression->walk(*this);
+    return nullptr;
+}
+
+Datum Resolver::statement(VarStatement& node) {
+    node.expression->walk(*this);
+    declare(node.identifier, node.address);
+    return nullptr;
+}
+
+Datum Resolver::statement(WhileStatement& node) {
+    node.condition->walk(*this);
+    node.layout = block(node.statements);
+    return nullptr;
+}
+
+Datum Resolver::expression(ArrayExpression& node) {
+    for (auto& expression : node.expressions) {
+        expression->walk(*this);
+    }
+    return nullptr;
+}
+
+Datum Resolver::expression(BinaryExpression& node) {
+    node.lhs->walk(*this);
+    node.rhs->walk(*this);
+    return nullptr;
+}
+
+Datum Resolver::expression(BoolExpression&) {
+    return nullptr;
+}
+
+Datum Resolver::expression(CallExpression& node) {
+    for (auto& expression : node.expressions) {
+        expression->walk(*this);
+    }
+    node.function->walk(*this);
+    return nullptr;
+}
+
+Datum Resolver::expression(FloatExpression&) {
+    return nullptr;
+}
+
+Datum Resolver::expression(FunctionExpression& node) {
+    node.layout = make_shared<Layout>();
+    node.layout->mask = 0;
+    node.layout->reusable = true;
+
+    levels.push_back({node.layout.get(), true});
+    for (auto& parameter : node.parameters) {
+        node.layout->parameters.push_back(node.layout->declare(parameter));
+    }
+    for (auto& statement : node.statements) {
+        statement->walk(*this);
+    }
+    levels.pop_back();
+    return nullptr;
+}
+
+Datum Resolver::expression(IntExpression&) {
+    return nullptr;
+}
+
+Datum Resolver::expression(NullExpression&) {
+    return nullptr;
+}
+
+Datum Resolver::expression(ObjectExpression& node) {
+    for (auto& pair : node.values) {
+        pair.second->walk(*this);
+    }
+    return nullptr;
+}
+
+Datum Resolver::expression(StringExpression& node) {
+    /* the value tells selectors that they can use an inline cache */
+    if (!node.constant) {
+        node.constant = make_shared<StringValue>(node.value);
+    }
+    return node.constant;
+}
+
+Datum Resolver::expression(UnaryExpression& node) {
+    node.rhs->walk(*this);
+    return nullptr;
+}
+
+Datum Resolver::expression(VariableExpression& node) {
+    resolve(node.identifier, node.address);
+
+    node.caches.clear();
+    for (auto& expression : node.expressions) {
+        const auto& key = expression->walk(*this);
+        if (key.getTag() == Datum::Tag::BOXED) {
+            node.caches.push_back(make_shared<InlineCache>(static_pointer_cast<StringValue>(key.getBoxed())));
+        } else {
+            node.caches.push_back(nullptr);
+        }
+    }
+    return nullptr;
+}
+
+} /* namespace noumenon */
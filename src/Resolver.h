@@ -0,0 +1,105 @@
+/*
+ * Noumenon: A dynamic, strongly typed script language.
+ * Copyright (C) 2015 Tim Wiederhake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef RESOLVER_H_
+#define RESOLVER_H_
+
+#include "Expression.h"
+#include "Statement.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace noumenon {
+
+/* static layout of the variables of a block or function body */
+struct Layout {
+    static unsigned long long maskOf(const Atom&);
+
+    /* variable name per slot */
+    std::vector<Atom> names;
+
+    /* slot per parameter, function bodies only */
+    std::vector<unsigned> parameters;
+
+    /* union of the masks of all names */
+    unsigned long long mask;
+
+    /*
+     * function bodies only: nothing but the parameters is declared in the body,
+     * so a tail call of the function can reuse its scope without any variable
+     * of the caller becoming invisible, see FunctionValue::doCall
+     */
+    bool reusable;
+
+    unsigned declare(const Atom&);
+};
+
+/*
+ * Assigns slots to all variables declared in nested scopes and resolves
+ * variable accesses to them. Functions are dynamically scoped, i.e. they see
+ * the variables of their caller, so names that are not declared within the
+ * enclosing function are looked up by name, skipping the scopes known to not
+ * contain them. Variables of the outermost scope are always looked up by name
+ * as well, as they are shared with the runtime and other statements.
+ */
+class Resolver : public StatementWalker, public ExpressionWalker {
+public:
+    static void resolve(Statement&);
+
+    Datum statement(AssignmentStatement&);
+    Datum statement(CallStatement&);
+    Datum statement(ForStatement&);
+    Datum statement(IfStatement&);
+    Datum statement(ReturnStatement&);
+    Datum statement(VarStatement&);
+    Datum statement(WhileStatement&);
+
+    Datum expression(ArrayExpression&);
+    Datum expression(BinaryExpression&);
+    Datum expression(BoolExpression&);
+    Datum expression(CallExpression&);
+    Datum expression(FloatExpression&);
+    Datum expression(FunctionExpression&);
+    Datum expression(IntExpression&);
+    Datum expression(NullExpression&);
+    Datum expression(ObjectExpression&);
+    Datum expression(StringExpression&);
+    Datum expression(UnaryExpression&);
+    Datum expression(VariableExpression&);
+
+private:
+    struct Level {
+        Layout* layout;
+        bool function;
+    };
+
+    Resolver();
+
+    void resolve(const Atom&, Address&);
+    void declare(const Atom&, Address&);
+    static bool declares(const std::vector<std::shared_ptr<Statement>>&);
+    std::shared_ptr<Layout> block(const std::vector<std::shared_ptr<Statement>>&);
+
+    std::vector<Level> levels;
+};
+
+} /* namespace noumenon */
+
+#endif /* RESOLVER_H_ */
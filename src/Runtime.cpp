@@ -17,241 +17,276 @@
  */
 
 #include "Runtime.h"
+#include "Modules.h"
+#include "Output.h"
 #include "Program.h"
 
-#include <fstream>
-#include <iostream>
-
 using namespace std;
 
 namespace noumenon {
 namespace rtl {
 
 struct PrintWalker : public ValueWalker {
-    PrintWalker(Program& scope) : scope(scope) {
+    PrintWalker(Program& scope) : scope(scope), output(Output::standard) {
     }
 
-    shared_ptr<Value> value(ArrayValue& node) {
-        cout << '[';
-        for(unsigned long long i = 0; i < node.getLength(); ++i) {
-            node.getValue(i)->walk(*this);
-
-            if (i >= node.getLength() - 1) {
-                cout << ']';
-                return nullptr;
+    Datum value(ArrayValue& node) {
+        output.write('[');
+        auto cursor = node.iterate();
+        for (bool first = true; cursor->next(); first = false) {
+            if (!first) {
+                output.write(", ", 2);
             }
-
-            cout << ", ";
+            cursor->getValue().walk(*this);
         }
 
-        cout << ']';
+        output.write(']');
         return nullptr;
     }
 
-    shared_ptr<Value> value(BoolValue& node) {
-        cout << (node.value ? "true" : "false");
+    Datum value(BoolValue& node) {
+        output.write(node.value ? "true" : "false", node.value ? 4 : 5);
         return nullptr;
     }
 
-    shared_ptr<Value> value(FloatValue& node) {
-        cout << node.value;
+    Datum value(FloatValue& node) {
+        output.write(node.value);
         return nullptr;
     }
 
-    shared_ptr<Value> value(FunctionValue& node) {
-        cout << "function(";
+    Datum value(FunctionValue& node) {
+        output.write("function(", 9);
         auto iterator = node.parameters.begin();
         while (iterator != node.parameters.end()) {
-            cout << StringValue::UTF32toUTF8(*iterator);
+            output.write(StringValue::UTF32toUTF8(*iterator));
 
             if (++iterator != node.parameters.end()) {
-                cout << ',';
+                output.write(',');
             }
         }
-        cout << ')';
+        output.write(')');
         return nullptr;
     }
 
-    shared_ptr<Value> value(IntValue& node) {
-        cout << node.value;
+    Datum value(IntValue& node) {
+        output.write(node.value);
         return nullptr;
     }
 
-    shared_ptr<Value> value(NullValue&) {
-        cout << "null";
+    Datum value(NullValue&) {
+        output.write("null", 4);
         return nullptr;
     }
 
-    shared_ptr<Value> value(ObjectValue& node) {
-        cout << '{';
-        auto iterator = node.values.begin();
-        while (iterator != node.values.end()) {
-            cout << StringValue::UTF32toUTF8(iterator->first) << ": ";
-            iterator->second->walk(*this);
-
-            if (++iterator != node.values.end()) {
-                cout << ", ";
+    Datum value(ObjectValue& node) {
+        output.write('{');
+        auto cursor = node.iterate();
+        for (bool first = true; cursor->next(); first = false) {
+            if (!first) {
+                output.write(", ", 2);
             }
+            cursor->getKey().walk(*this);
+            output.write(": ", 2);
+            cursor->getValue().walk(*this);
         }
-        cout << '}';
+        output.write('}');
         return nullptr;
     }
 
-    shared_ptr<Value> value(StringValue& node) {
-        cout << StringValue::UTF32toUTF8(node.value);
+    Datum value(StringValue& node) {
+        const auto text = node.getASCII();
+        if (text != nullptr) {
+            output.write(*text);
+        } else {
+            output.write(node.toUTF8());
+        }
         return nullptr;
     }
 
 private:
     Program& scope;
+    Output& output;
 };
 
 struct TypeWalker : public ValueWalker {
-    shared_ptr<Value> value(ArrayValue&) {
+    Datum value(ArrayValue&) {
         return make_shared<StringValue>(U"Array");
     }
 
-    shared_ptr<Value> value(BoolValue&) {
+    Datum value(BoolValue&) {
         return make_shared<StringValue>(U"Bool");
     }
 
-    shared_ptr<Value> value(FloatValue&) {
+    Datum value(FloatValue&) {
         return make_shared<StringValue>(U"Float");
     }
 
-    shared_ptr<Value> value(FunctionValue&) {
+    Datum value(FunctionValue&) {
         return make_shared<StringValue>(U"Function");
     }
 
-    shared_ptr<Value> value(IntValue&) {
+    Datum value(IntValue&) {
         return make_shared<StringValue>(U"Int");
     }
 
-    shared_ptr<Value> value(NullValue&) {
+    Datum value(NullValue&) {
         return make_shared<StringValue>(U"Null");
     }
 
-    shared_ptr<Value> value(ObjectValue&) {
+    Datum value(ObjectValue&) {
         return make_shared<StringValue>(U"Object");
     }
 
-    shared_ptr<Value> value(StringValue&) {
+    Datum value(StringValue&) {
         return make_shared<StringValue>(U"String");
     }
 };
 
-shared_ptr<Value> Print::doCall(Program& scope, vector<shared_ptr<Value>>& parameters) {
+Datum Print::doCall(Program& scope, vector<Datum>& parameters) {
     PrintWalker walker(scope);
     for (auto& parameter : parameters) {
-        parameter->walk(walker);
+        parameter.walk(walker);
     }
 
     return NullValue::singleton;
 }
 
-shared_ptr<Value> Println::doCall(Program& scope, vector<shared_ptr<Value>>& parameters) {
+Datum Println::doCall(Program& scope, vector<Datum>& parameters) {
     PrintWalker walker(scope);
     for (auto& parameter : parameters) {
-        parameter->walk(walker);
+        parameter.walk(walker);
     }
 
-    cout << endl;
+    Output::standard.line();
     return NullValue::singleton;
 }
 
-shared_ptr<Value> Typeof::doCall(Program&, vector<shared_ptr<Value>>& parameters) {
+Datum Flush::doCall(Program&, vector<Datum>&) {
+    Output::standard.flush();
+    return NullValue::singleton;
+}
+
+/* the first parameter if it is an array */
+static ArrayValue* arrayParameter(vector<Datum>& parameters) {
+    if (parameters.empty() || parameters[0].getTag() != Datum::Tag::BOXED || parameters[0].getType() != Type::ARRAY) {
+        return nullptr;
+    }
+    return static_cast<ArrayValue*>(parameters[0].getBoxed().get());
+}
+
+/* an index given as parameter, limited to the length of an array */
+static unsigned long long indexParameter(const Datum& parameter, const unsigned long long& length) {
+    const auto& index = parameter.getInt();
+    if (index < 0) {
+        return 0;
+    }
+    return (unsigned long long) index < length ? index : length;
+}
+
+Datum Typeof::doCall(Program&, vector<Datum>& parameters) {
     if (parameters.size() > 0) {
         TypeWalker walker;
-        return parameters[0]->walk(walker);
+        return parameters[0].walk(walker);
     }
 
     return NullValue::singleton;
 }
 
-shared_ptr<Value> Range::doCall(Program&, vector<shared_ptr<Value>>& parameters) {
+Datum Range::doCall(Program&, vector<Datum>& parameters) {
     if (parameters.size() < 2) {
         return NullValue::singleton;
     }
 
-    struct Walker : public DefaultValueWalker {
-        Walker() : result(), valid(false) {
+    for (decltype(parameters.size()) i = 0; i < parameters.size() && i < 3; ++i) {
+        if (parameters[i].getTag() != Datum::Tag::INT) {
+            return NullValue::singleton;
         }
+    }
 
-        shared_ptr<Value> value(IntValue& node) {
-            valid = true;
-            result = node.value;
-            return nullptr;
-        }
-
-        signed long long result;
-        bool valid;
-    } walkerFrom, walkerTo;
-
-    parameters[0]->walk(walkerFrom);
-    parameters[1]->walk(walkerTo);
-
-    if (!walkerFrom.valid || !walkerTo.valid) {
+    const auto step = parameters.size() > 2 ? parameters[2].getInt() : 1;
+    if (step == 0) {
         return NullValue::singleton;
     }
 
-    class RangeValue : public ArrayValue {
-    public:
-        RangeValue(const long long& from, const long long& to) : from(from), to(to) {
-        }
+    return RangeValue::between(parameters[0].getInt(), parameters[1].getInt(), step);
+}
 
-        unsigned long long getLength() {
-            return from < to ? to - from : 0;
-        }
+Datum Length::doCall(Program&, vector<Datum>& parameters) {
+    if (parameters.size() > 0) {
+        return Datum((signed long long) parameters[0].getLength());
+    }
 
-        std::shared_ptr<Value> getKey(const unsigned long long& index) {
-            return make_shared<IntValue>(index);
-        }
+    return NullValue::singleton;
+}
 
-        std::shared_ptr<Value> getValue(const unsigned long long& index) {
-            return make_shared<IntValue>(index + from);
-        }
+Datum Shift::doCall(Program&, vector<Datum>& parameters) {
+    const auto array = arrayParameter(parameters);
+    if (array == nullptr) {
+        return NullValue::singleton;
+    }
+
+    const auto length = array->getLength();
+    return array->slice(length > 0 ? 1 : 0, length);
+}
 
-    private:
-        const long long from;
-        const long long to;
-    };
+Datum Pop::doCall(Program&, vector<Datum>& parameters) {
+    const auto array = arrayParameter(parameters);
+    if (array == nullptr) {
+        return NullValue::singleton;
+    }
 
-    return make_shared<RangeValue>(walkerFrom.result, walkerTo.result);
+    const auto length = array->getLength();
+    return array->slice(0, length > 0 ? length - 1 : 0);
 }
 
-shared_ptr<Value> Length::doCall(Program&, vector<shared_ptr<Value>>& parameters) {
-    if (parameters.size() > 0) {
-        return make_shared<IntValue>(parameters[0]->getLength());
+Datum Slice::doCall(Program&, vector<Datum>& parameters) {
+    const auto array = arrayParameter(parameters);
+    if (array == nullptr || parameters.size() < 2 || parameters[1].getTag() != Datum::Tag::INT) {
+        return NullValue::singleton;
     }
 
-    return NullValue::singleton;
+    const auto length = array->getLength();
+    const auto from = indexParameter(parameters[1], length);
+    auto to = length;
+    if (parameters.size() > 2) {
+        if (parameters[2].getTag() != Datum::Tag::INT) {
+            return NullValue::singleton;
+        }
+        to = indexParameter(parameters[2], length);
+    }
+
+    return array->slice(from, from < to ? to : from);
 }
 
-shared_ptr<Value> List::doCall(Program& program, vector<shared_ptr<Value>>&) {
+Datum List::doCall(Program& program, vector<Datum>&) {
     PrintWalker walker(program);
-    cout << "Variables in current scope:" << endl;
+    auto& output = Output::standard;
+    output.write("Variables in current scope:\n", 28);
     for (Program* scope = &program; scope; scope = scope->getParent()) {
-        for (auto& value : scope->values) {
-            cout << "  " << StringValue::UTF32toUTF8(value.first) << " = ";
-            value.second->walk(walker);
-            cout << endl;
+        for (auto& value : scope->getVariables()) {
+            output.write("  ", 2);
+            output.write(StringValue::UTF32toUTF8(value.first));
+            output.write(" = ", 3);
+            value.second.walk(walker);
+            output.line();
         }
     }
     return NullValue::singleton;
 }
 
-shared_ptr<Value> Require::doCall(Program& program, vector<shared_ptr<Value>>& parameters) {
+/* the first parameter if it is a string, as the name of a file */
+static bool fileParameter(vector<Datum>& parameters, string& file) {
     if (parameters.size() < 1) {
-        return NullValue::singleton;
+        return false;
     }
 
     struct Walker : public DefaultValueWalker {
         Walker() : result(), valid(false) {
         }
 
-        shared_ptr<Value> value(StringValue& node) {
+        Datum value(StringValue& node) {
             valid = true;
-            result = StringValue::UTF32toUTF8(node.value);
+            result = node.toUTF8();
             return nullptr;
         }
 
@@ -259,25 +294,77 @@ shared_ptr<Value> Require::doCall(Program& program, vector<shared_ptr<Value>>& p
         bool valid;
     } walker;
 
-    parameters[0]->walk(walker);
-    if (!walker.valid) {
+    parameters[0].walk(walker);
+    file = walker.result;
+    return walker.valid;
+}
+
+/* run a module in a new scope, with the parameters after the file name as "arg" */
+static Datum runModule(Program& program, ModuleRegistry::Module& module, vector<Datum>& parameters) {
+    auto arguments = make_shared<ArrayValue>();
+    for (decltype(parameters.size()) i = 1; i < parameters.size(); ++i) {
+        arguments->doAppend(parameters[i]);
+    }
+
+    Program nestedProgram(program);
+    nestedProgram.insertVariable(U"arg", arguments);
+    return ModuleRegistry::run(nestedProgram, module);
+}
+
+Datum Require::doCall(Program& program, vector<Datum>& parameters) {
+    string file;
+    if (!fileParameter(parameters, file)) {
         return NullValue::singleton;
     }
 
-    ifstream file(walker.result);
-    if (!file) {
+    const auto module = program.getModules().find(file);
+    if (module == nullptr) {
         return NullValue::singleton;
+    }
+
+    const auto& returnValue = runModule(program, *module, parameters);
+    return returnValue.isEmpty() ? NullValue::singleton : returnValue;
+}
 
+Datum Import::doCall(Program& program, vector<Datum>& parameters) {
+    string file;
+    if (!fileParameter(parameters, file)) {
+        return NullValue::singleton;
     }
 
-    auto arguments = make_shared<ArrayValue>();
-    if (parameters.size() > 1) {
-        arguments->values.assign(parameters.begin() + 1, parameters.end());
+    const auto module = program.getModules().find(file);
+    if (module == nullptr) {
+        return NullValue::singleton;
     }
 
-    Program nestedProgram(program);
-    nestedProgram.insertVariable(U"arg", arguments);
-    return Program::execute(nestedProgram, file);
+    if (module->value.isEmpty()) {
+        const auto& returnValue = runModule(program, *module, parameters);
+        if (returnValue.isEmpty()) {
+            return NullValue::singleton;
+        }
+        module->value = returnValue;
+    }
+    return module->value;
+}
+
+Datum Reload::doCall(Program& program, vector<Datum>& parameters) {
+    string file;
+    if (!fileParameter(parameters, file)) {
+        return NullValue::singleton;
+    }
+
+    return Datum(program.getModules().reload(file));
+}
+
+Datum Modules::doCall(Program& program, vector<Datum>&) {
+    auto result = make_shared<ObjectValue>();
+    for (auto& module : program.getModules().getModules()) {
+        auto entry = make_shared<ObjectValue>();
+        entry->insert(U"loads", Datum((signed long long) module.second.loads));
+        entry->insert(U"seconds", Datum(module.second.time));
+        result->insert(StringValue::UTF8toUTF32(module.first), entry);
+    }
+    return result;
 }
 
 } /* namespace rtl */
@@ -25,31 +25,59 @@ namespace noumenon {
 namespace rtl {
 
 struct Print : public FunctionValue {
-    std::shared_ptr<Value> doCall(Program&, std::vector<std::shared_ptr<Value>>&);
+    Datum doCall(Program&, std::vector<Datum>&);
 };
 
 struct Println : public FunctionValue {
-    std::shared_ptr<Value> doCall(Program&, std::vector<std::shared_ptr<Value>>&);
+    Datum doCall(Program&, std::vector<Datum>&);
+};
+
+struct Flush : public FunctionValue {
+    Datum doCall(Program&, std::vector<Datum>&);
 };
 
 struct Typeof : public FunctionValue {
-    std::shared_ptr<Value> doCall(Program&, std::vector<std::shared_ptr<Value>>&);
+    Datum doCall(Program&, std::vector<Datum>&);
 };
 
 struct Range : public FunctionValue {
-    std::shared_ptr<Value> doCall(Program&, std::vector<std::shared_ptr<Value>>&);
+    Datum doCall(Program&, std::vector<Datum>&);
 };
 
 struct Length : public FunctionValue {
-    std::shared_ptr<Value> doCall(Program&, std::vector<std::shared_ptr<Value>>&);
+    Datum doCall(Program&, std::vector<Datum>&);
+};
+
+struct Shift : public FunctionValue {
+    Datum doCall(Program&, std::vector<Datum>&);
+};
+
+struct Pop : public FunctionValue {
+    Datum doCall(Program&, std::vector<Datum>&);
+};
+
+struct Slice : public FunctionValue {
+    Datum doCall(Program&, std::vector<Datum>&);
 };
 
 struct List : public FunctionValue {
-    std::shared_ptr<Value> doCall(Program&, std::vector<std::shared_ptr<Value>>&);
+    Datum doCall(Program&, std::vector<Datum>&);
 };
 
 struct Require : public FunctionValue {
-    std::shared_ptr<Value> doCall(Program&, std::vector<std::shared_ptr<Value>>&);
+    Datum doCall(Program&, std::vector<Datum>&);
+};
+
+struct Import : public FunctionValue {
+    Datum doCall(Program&, std::vector<Datum>&);
+};
+
+struct Reload : public FunctionValue {
+    Datum doCall(Program&, std::vector<Datum>&);
+};
+
+struct Modules : public FunctionValue {
+    Datum doCall(Program&, std::vector<Datum>&);
 };
 
 } /* namespace rtl */
@@ -24,35 +24,35 @@ namespace noumenon {
 Statement::~Statement() {
 }
 
-std::shared_ptr<Value> AssignmentStatement::walk(StatementWalker& walker) {
+Datum AssignmentStatement::walk(StatementWalker& walker) {
     return walker.statement(*this);
 }
 
-std::shared_ptr<Value> CallStatement::walk(StatementWalker& walker) {
+Datum CallStatement::walk(StatementWalker& walker) {
     return walker.statement(*this);
 }
 
-std::shared_ptr<Value> EmptyStatement::walk(StatementWalker&) {
+Datum EmptyStatement::walk(StatementWalker&) {
     return nullptr;
 }
 
-std::shared_ptr<Value> ForStatement::walk(StatementWalker& walker) {
+Datum ForStatement::walk(StatementWalker& walker) {
     return walker.statement(*this);
 }
 
-std::shared_ptr<Value> IfStatement::walk(StatementWalker& walker) {
+Datum IfStatement::walk(StatementWalker& walker) {
     return walker.statement(*this);
 }
 
-std::shared_ptr<Value> ReturnStatement::walk(StatementWalker& walker) {
+Datum ReturnStatement::walk(StatementWalker& walker) {
     return walker.statement(*this);
 }
 
-std::shared_ptr<Value> VarStatement::walk(StatementWalker& walker) {
+Datum VarStatement::walk(StatementWalker& walker) {
     return walker.statement(*this);
 }
 
-std::shared_ptr<Value> WhileStatement::walk(StatementWalker& walker) {
+Datum WhileStatement::walk(StatementWalker& walker) {
     return walker.statement(*this);
 }
 
@@ -19,87 +19,105 @@
 #ifndef STATEMENT_H_
 #define STATEMENT_H_
 
+#include "Expression.h"
+
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace noumenon {
 
 class StatementWalker;
-struct Expression;
-struct Value;
-struct VariableExpression;
+struct Chunk;
+struct Layout;
 
 struct Statement {
     virtual ~Statement() = 0;
-    virtual std::shared_ptr<Value> walk(StatementWalker& processor) = 0;
+    virtual Datum walk(StatementWalker& processor) = 0;
 };
 
 struct AssignmentStatement : public Statement {
     std::shared_ptr<VariableExpression> variable;
     std::shared_ptr<Expression> expression;
 
-    std::shared_ptr<Value> walk(StatementWalker&);
+    /* the expression if it adds something to the variable itself, set by the parser: an array may grow in place */
+    std::shared_ptr<BinaryExpression> append;
+
+    Datum walk(StatementWalker&);
 };
 
 struct CallStatement : public Statement {
     std::shared_ptr<VariableExpression> function;
     std::vector<std::shared_ptr<Expression>> expressions;
 
-    std::shared_ptr<Value> walk(StatementWalker&);
+    Datum walk(StatementWalker&);
 };
 
 struct EmptyStatement : public Statement {
-    std::shared_ptr<Value> walk(StatementWalker&);
+    Datum walk(StatementWalker&);
 };
 
 struct ForStatement : public Statement {
-    std::u32string key;
-    std::u32string value;
+    Atom key;
+    Atom value;
     std::shared_ptr<Expression> expression;
     std::vector<std::shared_ptr<Statement>> statements;
+    std::shared_ptr<Layout> layout;
+    Address keyAddress;
+    Address valueAddress;
 
-    std::shared_ptr<Value> walk(StatementWalker&);
+    Datum walk(StatementWalker&);
 };
 
 struct IfStatement : public Statement {
     std::shared_ptr<Expression> condition;
     std::vector<std::shared_ptr<Statement>> statementsThen;
     std::vector<std::shared_ptr<Statement>> statementsElse;
+    std::shared_ptr<Layout> layoutThen;
+    std::shared_ptr<Layout> layoutElse;
 
-    std::shared_ptr<Value> walk(StatementWalker&);
+    Datum walk(StatementWalker&);
 };
 
 struct ReturnStatement : public Statement {
     std::shared_ptr<Expression> expression;
 
-    std::shared_ptr<Value> walk(StatementWalker&);
+    /* the expression if it is a call, set by the parser: a call in tail position */
+    std::shared_ptr<CallExpression> tailCall;
+
+    Datum walk(StatementWalker&);
 };
 
 struct VarStatement : public Statement {
-    std::u32string identifier;
+    Atom identifier;
     std::shared_ptr<Expression> expression;
+    Address address;
 
-    std::shared_ptr<Value> walk(StatementWalker&);
+    Datum walk(StatementWalker&);
 };
 
 struct WhileStatement : public Statement {
     std::shared_ptr<Expression> condition;
     std::vector<std::shared_ptr<Statement>> statements;
+    std::shared_ptr<Layout> layout;
+
+    /* the loop compiled on its own, once it ran long enough to get native code */
+    std::shared_ptr<Chunk> chunk;
 
-    std::shared_ptr<Value> walk(StatementWalker&);
+    Datum walk(StatementWalker&);
 };
 
 class StatementWalker {
 public:
     virtual ~StatementWalker() = 0;
 
-    virtual std::shared_ptr<Value> statement(AssignmentStatement&) = 0;
-    virtual std::shared_ptr<Value> statement(CallStatement&) = 0;
-    virtual std::shared_ptr<Value> statement(ForStatement&) = 0;
-    virtual std::shared_ptr<Value> statement(IfStatement&) = 0;
-    virtual std::shared_ptr<Value> statement(ReturnStatement&) = 0;
-    virtual std::shared_ptr<Value> statement(VarStatement&) = 0;
-    virtual std::shared_ptr<Value> statement(WhileStatement&) = 0;
+    virtual Datum statement(AssignmentStatement&) = 0;
+    virtual Datum statement(CallStatement&) = 0;
+    virtual Datum statement(ForStatement&) = 0;
+    virtual Datum statement(IfStatement&) = 0;
+    virtual Datum statement(ReturnStatement&) = 0;
+    virtual Datum statement(VarStatement&) = 0;
+    virtual Datum statement(WhileStatement&) = 0;
 };
 
 } /* namespace noumenon */
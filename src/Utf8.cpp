@@ -0,0 +1,249 @@
+/*
+ * Noumenon: A dynamic, strongly typed script language.
+ * Copyright (C) 2015 Tim Wiederhake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#include "Utf8.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace noumenon {
+
+const char32_t Utf8::replacement;
+
+#ifdef __SSE2__
+/* copies ASCII characters sixteen at a time, returns the number copied */
+static size_t decodeASCII(const unsigned char* in, const size_t& size, char32_t* out) {
+    const auto zero = _mm_setzero_si128();
+    size_t i = 0;
+    while (i + 16 <= size) {
+        const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        if (_mm_movemask_epi8(bytes) != 0) {
+            break;
+        }
+
+        const auto low = _mm_unpacklo_epi8(bytes, zero);
+        const auto high = _mm_unpackhi_epi8(bytes, zero);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi16(low, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 4), _mm_unpackhi_epi16(low, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 8), _mm_unpacklo_epi16(high, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 12), _mm_unpackhi_epi16(high, zero));
+        i += 16;
+    }
+    return i;
+}
+
+static size_t encodeASCII(const unsigned char* in, const size_t& size, char* out) {
+    size_t i = 0;
+    while (i + 16 <= size) {
+        const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        if (_mm_movemask_epi8(bytes) != 0) {
+            break;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), bytes);
+        i += 16;
+    }
+    return i;
+}
+
+static size_t encodeASCII(const char16_t* in, const size_t& size, char* out) {
+    const auto high = _mm_set1_epi16(~0x7f);
+    const auto zero = _mm_setzero_si128();
+    size_t i = 0;
+    while (i + 16 <= size) {
+        const auto first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        const auto second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 8));
+        const auto any = _mm_and_si128(_mm_or_si128(first, second), high);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(any, zero)) != 0xffff) {
+            break;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(first, second));
+        i += 16;
+    }
+    return i;
+}
+
+static size_t encodeASCII(const char32_t* in, const size_t& size, char* out) {
+    const auto high = _mm_set1_epi32(~0x7f);
+    const auto zero = _mm_setzero_si128();
+    size_t i = 0;
+    while (i + 16 <= size) {
+        const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        const auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 4));
+        const auto c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 8));
+        const auto d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 12));
+        const auto any = _mm_and_si128(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d)), high);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(any, zero)) != 0xffff) {
+            break;
+        }
+        const auto low = _mm_packs_epi32(a, b);
+        const auto high16 = _mm_packs_epi32(c, d);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(low, high16));
+        i += 16;
+    }
+    return i;
+}
+#else
+static size_t decodeASCII(const unsigned char*, const size_t&, char32_t*) {
+    return 0;
+}
+
+template<typename Unit>
+static size_t encodeASCII(const Unit*, const size_t&, char*) {
+    return 0;
+}
+#endif
+
+char32_t Utf8::decode(const char* data, const size_t& size, size_t& length) {
+    const auto in = reinterpret_cast<const unsigned char*>(data);
+    const auto lead = in[0];
+    char32_t minimum;
+    char32_t result;
+    if (lead >= 0xc2 && lead <= 0xdf) {
+        length = 2;
+        minimum = 0x80;
+        result = lead & 0x1f;
+    } else if (lead >= 0xe0 && lead <= 0xef) {
+        length = 3;
+        minimum = 0x800;
+        result = lead & 0x0f;
+    } else if (lead >= 0xf0 && lead <= 0xf4) {
+        length = 4;
+        minimum = 0x10000;
+        result = lead & 0x07;
+    } else {
+        length = 1;
+        return Utf8::replacement;
+    }
+
+    if (length > size) {
+        length = 1;
+        return Utf8::replacement;
+    }
+
+    for (size_t i = 1; i < length; ++i) {
+        if ((in[i] & 0xc0) != 0x80) {
+            length = 1;
+            return Utf8::replacement;
+        }
+        result = (result << 6) | (in[i] & 0x3f);
+    }
+
+    if (result < minimum || result > 0x10ffff || (result >= 0xd800 && result <= 0xdfff)) {
+        length = 1;
+        return Utf8::replacement;
+    }
+    return result;
+}
+
+u32string Utf8::decode(const char* data, const size_t& size) {
+    const auto in = reinterpret_cast<const unsigned char*>(data);
+    u32string result(size, 0);
+    auto out = &result[0];
+
+    size_t i = 0;
+    size_t o = 0;
+    while (i < size) {
+        const auto count = decodeASCII(in + i, size - i, out + o);
+        i += count;
+        o += count;
+
+        while (i < size && in[i] < 0x80) {
+            out[o++] = in[i++];
+        }
+
+        if (i < size) {
+            size_t length;
+            out[o++] = decode(data + i, size - i, length);
+            i += length;
+        }
+    }
+
+    result.resize(o);
+    return result;
+}
+
+/* appends a code point, returns the number of bytes written */
+static size_t encodeCharacter(char32_t c, char* out) {
+    if (c >= 0xd800 && c <= 0xdfff) {
+        c = Utf8::replacement;
+    }
+
+    if (c < 0x80) {
+        out[0] = c;
+        return 1;
+    } else if (c < 0x800) {
+        out[0] = 0xc0 | (c >> 6);
+        out[1] = 0x80 | (c & 0x3f);
+        return 2;
+    } else if (c < 0x10000) {
+        out[0] = 0xe0 | (c >> 12);
+        out[1] = 0x80 | ((c >> 6) & 0x3f);
+        out[2] = 0x80 | (c & 0x3f);
+        return 3;
+    } else if (c <= 0x10ffff) {
+        out[0] = 0xf0 | (c >> 18);
+        out[1] = 0x80 | ((c >> 12) & 0x3f);
+        out[2] = 0x80 | ((c >> 6) & 0x3f);
+        out[3] = 0x80 | (c & 0x3f);
+        return 4;
+    }
+    return encodeCharacter(Utf8::replacement, out);
+}
+
+template<typename Unit>
+static string encodeUnits(const Unit* in, const size_t& size) {
+    /* a unit of one byte takes at most two bytes, any other at most four */
+    string result(size * (sizeof(Unit) == 1 ? 2 : 4), 0);
+    auto out = &result[0];
+
+    size_t i = 0;
+    size_t o = 0;
+    while (i < size) {
+        const auto count = encodeASCII(in + i, size - i, out + o);
+        i += count;
+        o += count;
+
+        while (i < size && in[i] < 0x80) {
+            out[o++] = in[i++];
+        }
+
+        if (i < size) {
+            o += encodeCharacter(in[i++], out + o);
+        }
+    }
+
+    result.resize(o);
+    return result;
+}
+
+string Utf8::encode(const unsigned char* in, const size_t& size) {
+    return encodeUnits(in, size);
+}
+
+string Utf8::encode(const char16_t* in, const size_t& size) {
+    return encodeUnits(in, size);
+}
+
+string Utf8::encode(const char32_t* in, const size_t& size) {
+    return encodeUnits(in, size);
+}
+
+} /* namespace noumenon */
@@ -0,0 +1,51 @@
+/*
+ * Noumenon: A dynamic, strongly typed script language.
+ * Copyright (C) 2015 Tim Wiederhake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef UTF8_H_
+#define UTF8_H_
+
+#include <cstddef>
+#include <string>
+
+namespace noumenon {
+
+/*
+ * Conversion between UTF-8 and code points. Malformed UTF-8 is validated
+ * rather than trusted: every byte that does not start a well formed sequence,
+ * including overlong forms and surrogates, decodes to U+FFFD, and so do code
+ * points that cannot be encoded. Runs of ASCII are converted sixteen bytes at
+ * a time where SSE2 is available.
+ */
+class Utf8 {
+public:
+    static const char32_t replacement = 0xfffd;
+
+    static std::u32string decode(const char*, const std::size_t&);
+
+    /* decodes the character at the start of a sequence of bytes that is not ASCII, sets the number of bytes it takes */
+    static char32_t decode(const char*, const std::size_t&, std::size_t& length);
+
+    /* Latin-1 characters, as stored by StringValue */
+    static std::string encode(const unsigned char*, const std::size_t&);
+    static std::string encode(const char16_t*, const std::size_t&);
+    static std::string encode(const char32_t*, const std::size_t&);
+};
+
+} /* namespace noumenon */
+
+#endif /* UTF8_H_ */
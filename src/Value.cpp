@@ -15,95 +15,1274 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see http://www.gnu.org/licenses/.
  */
-
 #include "Value.h"
 #include "Expression.h"
+#include "Jit.h"
+#include "Machine.h"
 #include "Program.h"
+#include "Resolver.h"
+#include "Utf8.h"
 
-#include <codecvt>
-#include <locale>
+#include <algorithm>
+#include <array>
+#include <cstring>
 
 using namespace std;
 
 namespace noumenon {
 
-Value::~Value() {
+Datum::Datum() : tag(Tag::EMPTY), integer(0) {
+}
+
+Datum::Datum(nullptr_t) : tag(Tag::EMPTY), integer(0) {
+}
+
+void Datum::unbox(shared_ptr<Value> value) {
+    if (!value) {
+        return;
+    }
+
+    /* scalars are always stored inline, so boxed scalars are unboxed here */
+    switch (value->type) {
+    case Type::NUL:
+        tag = Tag::NUL;
+        return;
+    case Type::BOOL:
+        tag = Tag::BOOL;
+        boolean = static_cast<BoolValue&>(*value).value;
+        return;
+    case Type::INT:
+        tag = Tag::INT;
+        integer = static_cast<IntValue&>(*value).value;
+        return;
+    case Type::FLOAT:
+        tag = Tag::FLOAT;
+        real = static_cast<FloatValue&>(*value).value;
+        return;
+    default:
+        break;
+    }
+
+    new (&boxed) shared_ptr<Value>(std::move(value));
+    tag = Tag::BOXED;
+}
+
+Datum::Datum(const Datum& other) : tag(Tag::EMPTY), integer(0) {
+    assign(other);
+}
+
+Datum::Datum(Datum&& other) : tag(other.tag), integer(0) {
+    if (tag == Tag::BOXED) {
+        new (&boxed) shared_ptr<Value>(std::move(other.boxed));
+        other.clear();
+    } else {
+        assign(other);
+    }
+}
+
+Datum& Datum::operator=(const Datum& other) {
+    if (this == &other) {
+        return *this;
+    }
+
+    if (tag != Tag::BOXED && other.tag != Tag::BOXED) {
+        assign(other);
+        return *this;
+    }
+
+    /* other may be owned by the value released here */
+    Datum copy(other);
+    clear();
+    return *this = std::move(copy);
+}
+
+Datum& Datum::operator=(Datum&& other) {
+    if (this == &other) {
+        return *this;
+    }
+
+    clear();
+    if (other.tag == Tag::BOXED) {
+        new (&boxed) shared_ptr<Value>(std::move(other.boxed));
+        tag = Tag::BOXED;
+        other.clear();
+    } else {
+        assign(other);
+    }
+    return *this;
+}
+
+void Datum::assign(const Datum& other) {
+    /* requires that no boxed value is held */
+    tag = other.tag;
+    switch (tag) {
+    case Tag::BOOL:
+        boolean = other.boolean;
+        break;
+    case Tag::INT:
+        integer = other.integer;
+        break;
+    case Tag::FLOAT:
+        real = other.real;
+        break;
+    case Tag::BOXED:
+        new (&boxed) shared_ptr<Value>(other.boxed);
+        break;
+    default:
+        break;
+    }
+}
+
+void Datum::clear() {
+    if (tag == Tag::BOXED) {
+        boxed.~shared_ptr<Value>();
+    }
+    tag = Tag::EMPTY;
+}
+
+shared_ptr<Value> Datum::box() const {
+    switch (tag) {
+    case Tag::EMPTY:
+        return nullptr;
+    case Tag::BOOL:
+        return boolean ? BoolValue::trueSingleton : BoolValue::falseSingleton;
+    case Tag::INT:
+        return IntValue::create(integer);
+    case Tag::FLOAT:
+        return make_shared<FloatValue>(real);
+    case Tag::BOXED:
+        return boxed;
+    default:
+        return NullValue::singleton;
+    }
+}
+
+Datum Datum::walk(ValueWalker& walker) const {
+    switch (tag) {
+    case Tag::BOOL: {
+        BoolValue value(boolean);
+        return walker.value(value);
+    }
+    case Tag::INT: {
+        IntValue value(integer);
+        return walker.value(value);
+    }
+    case Tag::FLOAT: {
+        FloatValue value(real);
+        return walker.value(value);
+    }
+    case Tag::BOXED:
+        return boxed->walk(walker);
+    default:
+        return walker.value(*NullValue::singleton);
+    }
+}
+
+bool Datum::isTrue() const {
+    switch (tag) {
+    case Tag::BOOL:
+        return boolean;
+    case Tag::BOXED:
+        return boxed->isTrue();
+    default:
+        return false;
+    }
+}
+
+Datum Datum::doSelect(const Datum& index) const {
+    if (tag == Tag::BOXED) {
+        return boxed->doSelect(index);
+    }
+    return NullValue::singleton;
+}
+
+Datum Datum::doSelect(InlineCache& cache) const {
+    if (tag == Tag::BOXED) {
+        return boxed->doSelect(cache);
+    }
+    return NullValue::singleton;
+}
+
+/*
+ * Result of an operation on values of the types L and R. Operators that
+ * defines() does not list always yield null.
+ */
+template<Type L, Type R>
+struct Binary {
+    static constexpr bool defines(const BinaryOperator&) {
+        return false;
+    }
+
+    static Datum apply(const BinaryOperator&, const Datum&, const Datum&) {
+        return NullValue::singleton;
+    }
+};
+
+template<>
+struct Binary<Type::BOOL, Type::BOOL> {
+    static constexpr bool defines(const BinaryOperator& oper) {
+        return oper == BinaryOperator::AND || oper == BinaryOperator::OR || oper == BinaryOperator::EQU || oper == BinaryOperator::NEQ;
+    }
+
+    static Datum apply(const BinaryOperator& oper, const Datum& lhs, const Datum& rhs) {
+        return Datum::binaryBool(oper, lhs.getBool(), rhs.getBool());
+    }
+};
+
+template<>
+struct Binary<Type::INT, Type::INT> {
+    static constexpr bool defines(const BinaryOperator& oper) {
+        return oper != BinaryOperator::AND && oper != BinaryOperator::OR;
+    }
+
+    static Datum apply(const BinaryOperator& oper, const Datum& lhs, const Datum& rhs) {
+        return Datum::binaryInt(oper, lhs.getInt(), rhs.getInt());
+    }
+};
+
+template<>
+struct Binary<Type::INT, Type::FLOAT> {
+    static constexpr bool defines(const BinaryOperator& oper) {
+        return oper != BinaryOperator::MOD && oper != BinaryOperator::AND && oper != BinaryOperator::OR && oper != BinaryOperator::EQU && oper != BinaryOperator::NEQ;
+    }
+
+    static Datum apply(const BinaryOperator& oper, const Datum& lhs, const Datum& rhs) {
+        return Datum::binaryFloat(oper, lhs.getInt(), rhs.getFloat(), true);
+    }
+};
+
+template<>
+struct Binary<Type::FLOAT, Type::INT> {
+    static constexpr bool defines(const BinaryOperator& oper) {
+        return oper != BinaryOperator::MOD && oper != BinaryOperator::AND && oper != BinaryOperator::OR && oper != BinaryOperator::EQU && oper != BinaryOperator::NEQ;
+    }
+
+    static Datum apply(const BinaryOperator& oper, const Datum& lhs, const Datum& rhs) {
+        return Datum::binaryFloat(oper, lhs.getFloat(), rhs.getInt(), true);
+    }
+};
+
+template<>
+struct Binary<Type::FLOAT, Type::FLOAT> {
+    static constexpr bool defines(const BinaryOperator& oper) {
+        return oper != BinaryOperator::MOD && oper != BinaryOperator::AND && oper != BinaryOperator::OR;
+    }
+
+    static Datum apply(const BinaryOperator& oper, const Datum& lhs, const Datum& rhs) {
+        return Datum::binaryFloat(oper, lhs.getFloat(), rhs.getFloat(), false);
+    }
+};
+
+template<Type R>
+struct Binary<Type::ARRAY, R> {
+    static constexpr bool defines(const BinaryOperator& oper) {
+        return oper == BinaryOperator::ADD || oper == BinaryOperator::SUB;
+    }
+
+    static Datum apply(const BinaryOperator& oper, const Datum& lhs, const Datum& rhs) {
+        const auto& array = static_cast<ArrayValue&>(*lhs.getBoxed());
+
+        /* add element */
+        if (oper == BinaryOperator::ADD) {
+            vector<Datum> values;
+            values.reserve(array.end() - array.begin() + 1);
+            values.insert(values.end(), array.begin(), array.end());
+            values.push_back(rhs);
+            return make_shared<ArrayValue>(move(values));
+        }
+
+        /* remove element */
+        if (oper == BinaryOperator::SUB) {
+            vector<Datum> values;
+            for (auto value = array.begin(); value != array.end(); ++value) {
+                if (!value->doBinary(BinaryOperator::EQU, rhs).isTrue()) {
+                    values.push_back(*value);
+                }
+            }
+            return make_shared<ArrayValue>(move(values));
+        }
+
+        return NullValue::singleton;
+    }
+};
+
+template<>
+struct Binary<Type::OBJECT, Type::STRING> {
+    static constexpr bool defines(const BinaryOperator& oper) {
+        return oper == BinaryOperator::SUB;
+    }
+
+    static Datum apply(const BinaryOperator& oper, const Datum& lhs, const Datum& rhs) {
+        if (oper == BinaryOperator::SUB) {
+            auto returnValue = make_shared<ObjectValue>(static_cast<ObjectValue&>(*lhs.getBoxed()));
+            returnValue->erase(static_cast<StringValue&>(*rhs.getBoxed()).toUTF32());
+            return returnValue;
+        }
+        return NullValue::singleton;
+    }
+};
+
+template<>
+struct Binary<Type::OBJECT, Type::OBJECT> {
+    static constexpr bool defines(const BinaryOperator& oper) {
+        return oper == BinaryOperator::AND || oper == BinaryOperator::OR || oper == BinaryOperator::EQU || oper == BinaryOperator::NEQ;
+    }
+
+    static Datum apply(const BinaryOperator& oper, const Datum& lhsDatum, const Datum& rhsDatum) {
+        auto& lhs = static_cast<ObjectValue&>(*lhsDatum.getBoxed());
+        auto& rhs = static_cast<ObjectValue&>(*rhsDatum.getBoxed());
+        auto returnValue = make_shared<ObjectValue>(lhs);
+        const auto length = rhs.getLength();
+
+        switch (oper) {
+        case BinaryOperator::AND:
+            for (decltype(rhs.getLength()) i = 0; i < length; ++i) {
+                if (returnValue->find(rhs.keyAt(i)).isEmpty()) {
+                    returnValue->erase(rhs.keyAt(i));
+                }
+            }
+            return returnValue;
+
+        case BinaryOperator::OR:
+            for (decltype(rhs.getLength()) i = 0; i < length; ++i) {
+                if (returnValue->find(rhs.keyAt(i)).isEmpty()) {
+                    returnValue->insert(rhs.keyAt(i), rhs.valueAt(i));
+                }
+            }
+            return returnValue;
+
+        case BinaryOperator::EQU:
+            if (lhs.getLength() != length) {
+                return Datum(false);
+            }
+
+            for (decltype(rhs.getLength()) i = 0; i < length; ++i) {
+                const auto& value = lhs.find(rhs.keyAt(i));
+
+                if (value.isEmpty()) {
+                    return Datum(false);
+                }
+
+                if (!value.doBinary(BinaryOperator::EQU, rhs.valueAt(i)).isTrue()) {
+                    return Datum(false);
+                }
+            }
+
+            return Datum(true);
+
+        case BinaryOperator::NEQ:
+            if (lhs.getLength() != length) {
+                return Datum(true);
+            }
+
+            for (decltype(rhs.getLength()) i = 0; i < length; ++i) {
+                const auto& value = lhs.find(rhs.keyAt(i));
+
+                if (value.isEmpty()) {
+                    return Datum(true);
+                }
+
+                if (!value.doBinary(BinaryOperator::NEQ, rhs.valueAt(i)).isTrue()) {
+                    return Datum(true);
+                }
+            }
+
+            return Datum(false);
+
+        default:
+            break;
+        }
+        return NullValue::singleton;
+    }
+};
+
+template<Type R>
+struct Binary<Type::STRING, R> {
+    static constexpr bool defines(const BinaryOperator& oper) {
+        return oper == BinaryOperator::ADD;
+    }
+
+    static Datum apply(const BinaryOperator& oper, const Datum& lhs, const Datum& rhs) {
+        if (oper != BinaryOperator::ADD) {
+            return NullValue::singleton;
+        }
+
+        /* numbers are printed in ASCII, which needs no conversion */
+        const auto number = [](const string& digits) {
+            return make_shared<StringValue>(u32string(digits.begin(), digits.end()));
+        };
+
+        const auto value = static_pointer_cast<StringValue>(lhs.getBoxed());
+        switch (R) {
+        case Type::NUL:
+            return make_shared<StringValue>(value, make_shared<StringValue>(U"null"));
+        case Type::BOOL:
+            return make_shared<StringValue>(value, make_shared<StringValue>(rhs.getBool() ? U"true" : U"false"));
+        case Type::INT:
+            return make_shared<StringValue>(value, number(to_string(rhs.getInt())));
+        case Type::FLOAT:
+            return make_shared<StringValue>(value, number(to_string(rhs.getFloat())));
+        case Type::ARRAY:
+            return make_shared<StringValue>(value, make_shared<StringValue>(U"Array"));
+        case Type::FUNCTION:
+            return make_shared<StringValue>(value, make_shared<StringValue>(U"Function"));
+        case Type::OBJECT:
+            return make_shared<StringValue>(value, make_shared<StringValue>(U"Object"));
+        default:
+            return NullValue::singleton;
+        }
+    }
+};
+
+template<>
+struct Binary<Type::STRING, Type::STRING> {
+    static constexpr bool defines(const BinaryOperator& oper) {
+        return oper == BinaryOperator::ADD || oper == BinaryOperator::EQU || oper == BinaryOperator::NEQ;
+    }
+
+    static Datum apply(const BinaryOperator& oper, const Datum& lhs, const Datum& rhs) {
+        const auto& lhsValue = static_cast<StringValue&>(*lhs.getBoxed());
+        const auto& rhsValue = static_cast<StringValue&>(*rhs.getBoxed());
+
+        switch (oper) {
+        case BinaryOperator::ADD:
+            return make_shared<StringValue>(static_pointer_cast<StringValue>(lhs.getBoxed()), static_pointer_cast<StringValue>(rhs.getBoxed()));
+        case BinaryOperator::EQU:
+            return Datum(lhsValue.equals(rhsValue));
+        case BinaryOperator::NEQ:
+            return Datum(!lhsValue.equals(rhsValue));
+        default:
+            break;
+        }
+        return NullValue::singleton;
+    }
+};
+
+template<Type T>
+struct Unary {
+    static constexpr bool defines(const UnaryOperator&) {
+        return false;
+    }
+
+    static Datum apply(const UnaryOperator&, const Datum&) {
+        return NullValue::singleton;
+    }
+};
+
+template<>
+struct Unary<Type::BOOL> {
+    static constexpr bool defines(const UnaryOperator& oper) {
+        return oper == UnaryOperator::NOT;
+    }
+
+    static Datum apply(const UnaryOperator& oper, const Datum& rhs) {
+        return Datum::unaryBool(oper, rhs.getBool());
+    }
+};
+
+template<>
+struct Unary<Type::INT> {
+    static constexpr bool defines(const UnaryOperator& oper) {
+        return oper == UnaryOperator::NEG;
+    }
+
+    static Datum apply(const UnaryOperator& oper, const Datum& rhs) {
+        return Datum::unaryInt(oper, rhs.getInt());
+    }
+};
+
+template<>
+struct Unary<Type::FLOAT> {
+    static constexpr bool defines(const UnaryOperator& oper) {
+        return oper == UnaryOperator::NEG;
+    }
+
+    static Datum apply(const UnaryOperator& oper, const Datum& rhs) {
+        return Datum::unaryFloat(oper, rhs.getFloat());
+    }
+};
+
+/*
+ * Dispatch tables indexed by operand types and operator. Every entry is an
+ * instance of binary() or unary() for constant types and operator, so the
+ * checks above fold away and an operation costs one indirect call.
+ */
+typedef Datum (*BinaryEntry)(const Datum&, const Datum&);
+typedef Datum (*UnaryEntry)(const Datum&);
+
+static const unsigned typeCount = 8;
+static const unsigned binaryOperatorCount = 13;
+static const unsigned unaryOperatorCount = 2;
+
+template<Type L, Type R, BinaryOperator O>
+static Datum binary(const Datum& lhs, const Datum& rhs) {
+    return Binary<L, R>::apply(O, lhs, rhs);
+}
+
+template<Type T, UnaryOperator O>
+static Datum unary(const Datum& rhs) {
+    return Unary<T>::apply(O, rhs);
+}
+
+/* all operations yielding null share one entry, which keeps the indirect calls predictable */
+static Datum binaryNull(const Datum&, const Datum&) {
+    return NullValue::singleton;
+}
+
+static Datum unaryNull(const Datum&) {
+    return NullValue::singleton;
+}
+
+template<Type L, Type R, BinaryOperator O>
+constexpr BinaryEntry binaryEntry() {
+    return Binary<L, R>::defines(O) ? binary<L, R, O> : binaryNull;
+}
+
+template<Type T, UnaryOperator O>
+constexpr UnaryEntry unaryEntry() {
+    return Unary<T>::defines(O) ? unary<T, O> : unaryNull;
+}
+
+template<Type L, Type R>
+constexpr array<BinaryEntry, binaryOperatorCount> binaryOperators() {
+    return {{
+        binaryEntry<L, R, BinaryOperator::ADD>(),
+        binaryEntry<L, R, BinaryOperator::SUB>(),
+        binaryEntry<L, R, BinaryOperator::MUL>(),
+        binaryEntry<L, R, BinaryOperator::DIV>(),
+        binaryEntry<L, R, BinaryOperator::MOD>(),
+        binaryEntry<L, R, BinaryOperator::AND>(),
+        binaryEntry<L, R, BinaryOperator::OR>(),
+        binaryEntry<L, R, BinaryOperator::EQU>(),
+        binaryEntry<L, R, BinaryOperator::NEQ>(),
+        binaryEntry<L, R, BinaryOperator::LES>(),
+        binaryEntry<L, R, BinaryOperator::LEQ>(),
+        binaryEntry<L, R, BinaryOperator::GRT>(),
+        binaryEntry<L, R, BinaryOperator::GEQ>()
+    }};
+}
+
+template<Type L, Type... R>
+constexpr array<array<BinaryEntry, binaryOperatorCount>, typeCount> binaryRow() {
+    return {{binaryOperators<L, R>()...}};
+}
+
+template<Type... T>
+constexpr array<array<array<BinaryEntry, binaryOperatorCount>, typeCount>, typeCount> binaryTable() {
+    return {{binaryRow<T, T...>()...}};
+}
+
+template<Type... T>
+constexpr array<array<UnaryEntry, unaryOperatorCount>, typeCount> unaryTable() {
+    return {{{{unaryEntry<T, UnaryOperator::NEG>(), unaryEntry<T, UnaryOperator::NOT>()}}...}};
+}
+
+/* must list the types in the order of their declaration */
+static constexpr array<array<array<BinaryEntry, binaryOperatorCount>, typeCount>, typeCount> binaryOperations = binaryTable<Type::NUL, Type::BOOL, Type::INT, Type::FLOAT, Type::ARRAY, Type::FUNCTION, Type::OBJECT, Type::STRING>();
+static constexpr array<array<UnaryEntry, unaryOperatorCount>, typeCount> unaryOperations = unaryTable<Type::NUL, Type::BOOL, Type::INT, Type::FLOAT, Type::ARRAY, Type::FUNCTION, Type::OBJECT, Type::STRING>();
+
+Datum Datum::doUnary(const UnaryOperator& oper) const {
+    return unaryOperations[static_cast<unsigned>(getType())][static_cast<unsigned>(oper)](*this);
+}
+
+Datum Datum::doBinary(const BinaryOperator& oper, const Datum& rhs) const {
+    return binaryOperations[static_cast<unsigned>(getType())][static_cast<unsigned>(rhs.getType())][static_cast<unsigned>(oper)](*this, rhs);
+}
+
+Datum Datum::doCall(Program& scope, vector<Datum>& values) const {
+    if (tag == Tag::BOXED) {
+        return boxed->doCall(scope, values);
+    }
+    return NullValue::singleton;
+}
+
+void Datum::doModify(const Datum& index, const Datum& value) const {
+    if (tag == Tag::BOXED) {
+        boxed->doModify(index, value);
+    }
+}
+
+void Datum::doModify(InlineCache& cache, const Datum& value) const {
+    if (tag == Tag::BOXED) {
+        boxed->doModify(cache, value);
+    }
+}
+
+unsigned long long Datum::getLength() const {
+    if (tag == Tag::BOXED) {
+        return boxed->getLength();
+    }
+    return 0;
+}
+
+Datum Datum::getKey(const unsigned long long& index) const {
+    if (tag == Tag::BOXED) {
+        return boxed->getKey(index);
+    }
+    return NullValue::singleton;
+}
+
+Datum Datum::getValue(const unsigned long long& index) const {
+    if (tag == Tag::BOXED) {
+        return boxed->getValue(index);
+    }
+    return NullValue::singleton;
+}
+
+const Shape* Shape::empty() {
+    static const Shape* shape = of({});
+    return shape;
+}
+
+const Shape* Shape::of(const vector<u32string>& sortedKeys) {
+    static map<vector<u32string>, unique_ptr<Shape>> shapes;
+
+    auto& shape = shapes[sortedKeys];
+    if (!shape) {
+        shape.reset(new Shape(sortedKeys));
+    }
+    return shape.get();
+}
+
+Shape::Shape(const vector<u32string>& keys) : keys(keys) {
+}
+
+const vector<u32string>& Shape::getKeys() const {
+    return keys;
+}
+
+unsigned Shape::find(const u32string& key) const {
+    const auto& iterator = lower_bound(keys.begin(), keys.end(), key);
+    if (iterator != keys.end() && *iterator == key) {
+        return iterator - keys.begin();
+    }
+    return npos;
+}
+
+unsigned Shape::find(const StringValue& key) const {
+    const auto& iterator = lower_bound(keys.begin(), keys.end(), key, [](const u32string& lhs, const StringValue& rhs) {
+        return rhs.compare(lhs) > 0;
+    });
+    if (iterator != keys.end() && key.compare(*iterator) == 0) {
+        return iterator - keys.begin();
+    }
+    return npos;
+}
+
+const unsigned Dictionary::npos;
+
+/* FNV-1a over the characters of a string, whatever its representation */
+template<typename String>
+static size_t hashCharacters(const String& string, const unsigned long long& size) {
+    size_t result = 14695981039346656037ull;
+    for (unsigned long long i = 0; i < size; ++i) {
+        result = (result ^ (size_t) string.at(i)) * 1099511628211ull;
+    }
+    return result;
+}
+
+static bool sameKey(const u32string& key, const u32string& other) {
+    return key == other;
+}
+
+static bool sameKey(const u32string& key, const StringValue& other) {
+    return other.compare(key) == 0;
+}
+
+size_t Dictionary::hash(const u32string& key) {
+    return hashCharacters(key, key.size());
+}
+
+Dictionary::Dictionary() : entries(), table(), order(), sorted(true) {
+}
+
+unsigned long long Dictionary::size() const {
+    return entries.size();
+}
+
+template<typename Key>
+unsigned long long Dictionary::locate(const Key& key, const size_t& hash) const {
+    if (entries.empty()) {
+        return npos;
+    }
+
+    const auto mask = table.size() - 1;
+    for (auto position = hash & mask; table[position] != npos; position = (position + 1) & mask) {
+        const auto& entry = entries[table[position]];
+        if (entry.hash == hash && sameKey(entry.key, key)) {
+            return position;
+        }
+    }
+    return npos;
+}
+
+Datum* Dictionary::find(const u32string& key, const size_t& hash) {
+    const auto position = locate(key, hash);
+    return position == npos ? nullptr : &entries[table[position]].value;
+}
+
+const Datum* Dictionary::find(const u32string& key, const size_t& hash) const {
+    const auto position = locate(key, hash);
+    return position == npos ? nullptr : &entries[table[position]].value;
+}
+
+Datum* Dictionary::find(const StringValue& key) {
+    const auto position = locate(key, key.getHash());
+    return position == npos ? nullptr : &entries[table[position]].value;
+}
+
+const Datum* Dictionary::find(const StringValue& key) const {
+    const auto position = locate(key, key.getHash());
+    return position == npos ? nullptr : &entries[table[position]].value;
+}
+
+void Dictionary::place(const unsigned& index) {
+    const auto mask = table.size() - 1;
+    auto position = entries[index].hash & mask;
+    while (table[position] != npos) {
+        position = (position + 1) & mask;
+    }
+    table[position] = index;
+}
+
+void Dictionary::insert(const u32string& key, const size_t& hash, const Datum& value) {
+    const auto existing = find(key, hash);
+    if (existing != nullptr) {
+        *existing = value;
+        return;
+    }
+
+    entries.push_back({key, hash, value});
+    sorted = false;
+
+    /* at most half of the table is in use */
+    if (entries.size() * 2 > table.size()) {
+        table.assign(table.empty() ? 2 * capacity : 2 * table.size(), npos);
+        for (unsigned i = 0; i < entries.size(); ++i) {
+            place(i);
+        }
+    } else {
+        place(entries.size() - 1);
+    }
+}
+
+void Dictionary::erase(const u32string& key, const size_t& hash) {
+    auto position = locate(key, hash);
+    if (position == npos) {
+        return;
+    }
+
+    const auto index = table[position];
+    const auto mask = table.size() - 1;
+
+    /* move following entries of the same probe sequence up, so no probe stops early */
+    table[position] = npos;
+    for (auto next = (position + 1) & mask; table[next] != npos; next = (next + 1) & mask) {
+        const auto home = entries[table[next]].hash & mask;
+        if (((next - home) & mask) >= ((next - position) & mask)) {
+            table[position] = table[next];
+            table[next] = npos;
+            position = next;
+        }
+    }
+
+    /* the last entry takes the place of the erased one */
+    const unsigned last = entries.size() - 1;
+    if (index != last) {
+        for (auto slot = entries[last].hash & mask;; slot = (slot + 1) & mask) {
+            if (table[slot] == last) {
+                table[slot] = index;
+                break;
+            }
+        }
+        entries[index] = std::move(entries[last]);
+    }
+    entries.pop_back();
+    sorted = false;
+}
+
+void Dictionary::sort() const {
+    if (sorted) {
+        return;
+    }
+
+    order.resize(entries.size());
+    for (unsigned i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [this](const unsigned& lhs, const unsigned& rhs) {
+        return entries[lhs].key < entries[rhs].key;
+    });
+    sorted = true;
+}
+
+const u32string& Dictionary::keyAt(const unsigned long long& index) const {
+    sort();
+    return entries[order[index]].key;
+}
+
+const Datum& Dictionary::valueAt(const unsigned long long& index) const {
+    sort();
+    return entries[order[index]].value;
+}
+
+InlineCache::InlineCache(const shared_ptr<StringValue>& key) : key(key), shapes(), slots(), count(0) {
+}
+
+Value::Value(const Type& type) : type(type) {
+}
+
+Value::~Value() {
+}
+
+ArrayValue::ArrayValue() : Value(Type::ARRAY), storage(make_shared<vector<Datum>>()), from(0), to(0) {
+}
+
+ArrayValue::ArrayValue(vector<Datum> values) : Value(Type::ARRAY), storage(make_shared<vector<Datum>>(move(values))), from(0), to(storage->size()) {
+}
+
+RangeValue::RangeValue(const signed long long& first, const signed long long& step, const unsigned long long& count) : ArrayValue(), first(first), step(step), count(count) {
+}
+
+shared_ptr<RangeValue> RangeValue::between(const signed long long& from, const signed long long& to, const signed long long& step) {
+    /* distances as unsigned numbers, which cannot overflow */
+    unsigned long long distance = 0;
+    unsigned long long stride = 0;
+    if (step > 0 && from < to) {
+        distance = (unsigned long long) to - (unsigned long long) from;
+        stride = step;
+    } else if (step < 0 && from > to) {
+        distance = (unsigned long long) from - (unsigned long long) to;
+        stride = -(unsigned long long) step;
+    }
+
+    const auto count = stride == 0 ? 0 : distance / stride + (distance % stride != 0);
+    return make_shared<RangeValue>(from, step, count);
+}
+
+signed long long RangeValue::at(const unsigned long long& index) const {
+    return (signed long long) ((unsigned long long) first + index * (unsigned long long) step);
+}
+
+shared_ptr<ArrayValue> ArrayValue::slice(const unsigned long long& from, const unsigned long long& to) {
+    auto result = make_shared<ArrayValue>();
+    result->storage = storage;
+    result->from = this->from + from;
+    result->to = this->from + to;
+    return result;
+}
+
+shared_ptr<ArrayValue> RangeValue::slice(const unsigned long long& from, const unsigned long long& to) {
+    return make_shared<RangeValue>(at(from), step, to - from);
+}
+
+const Datum* ArrayValue::begin() const {
+    return storage->data() + from;
+}
+
+const Datum* ArrayValue::end() const {
+    return storage->data() + to;
+}
+
+void ArrayValue::own() {
+    if (storage.use_count() > 1) {
+        storage = make_shared<vector<Datum>>(begin(), end());
+    } else if (from > storage->size() / 2) {
+        /* a queue that is shifted from and appended to would grow forever */
+        storage->erase(storage->begin() + to, storage->end());
+        storage->erase(storage->begin(), storage->begin() + from);
+    } else {
+        return;
+    }
+
+    to -= from;
+    from = 0;
+}
+
+std::shared_ptr<BoolValue> BoolValue::trueSingleton = make_shared<BoolValue>(true);
+
+std::shared_ptr<BoolValue> BoolValue::falseSingleton = make_shared<BoolValue>(false);
+
+BoolValue::BoolValue(const bool& value) : Value(Type::BOOL), value(value) {
+}
+
+FloatValue::FloatValue(const double& value) : Value(Type::FLOAT), value(value) {
+}
+
+FunctionValue::FunctionValue() : Value(Type::FUNCTION), parameters(), statements(), layout(), chunk(), calls(0) {
+}
+
+FunctionValue::FunctionValue(const std::vector<Atom>& parameters, const std::vector<std::shared_ptr<Statement>>& statements) : Value(Type::FUNCTION), parameters(parameters.begin(), parameters.end()), statements(statements.begin(), statements.end()), layout(), chunk(), calls(0) {
+}
+
+std::shared_ptr<IntValue> IntValue::create(const signed long long& value) {
+    static const signed long long first = -128;
+    static const signed long long last = 1023;
+    static vector<shared_ptr<IntValue>> cache;
+
+    if (value < first || value > last) {
+        return make_shared<IntValue>(value);
+    }
+
+    if (cache.empty()) {
+        for (auto i = first; i <= last; ++i) {
+            cache.push_back(make_shared<IntValue>(i));
+        }
+    }
+    return cache[value - first];
+}
+
+IntValue::IntValue(const signed long long& value) : Value(Type::INT), value(value) {
+}
+
+NullValue::NullValue() : Value(Type::NUL) {
+}
+
+std::shared_ptr<NullValue> NullValue::singleton = make_shared<NullValue>();
+
+ObjectValue::ObjectValue() : Value(Type::OBJECT), shape(Shape::empty()), slots(), dictionary() {
+}
+
+ObjectValue::ObjectValue(const map<u32string, Datum>& values) : Value(Type::OBJECT), shape(nullptr), slots(), dictionary() {
+    for (const auto& pair : values) {
+        dictionary.insert(pair.first, Dictionary::hash(pair.first), pair.second);
+    }
+}
+
+ObjectValue::ObjectValue(const Shape* shape, vector<Datum>&& slots) : Value(Type::OBJECT), shape(shape), slots(std::move(slots)), dictionary() {
+}
+
+Datum ObjectValue::find(const u32string& key) const {
+    if (shape == nullptr) {
+        const auto value = dictionary.find(key, Dictionary::hash(key));
+        return value == nullptr ? nullptr : *value;
+    }
+
+    const auto& slot = shape->find(key);
+    if (slot == Shape::npos) {
+        return nullptr;
+    }
+    return slots[slot];
+}
+
+Datum ObjectValue::find(const StringValue& key) const {
+    if (shape == nullptr) {
+        const auto value = dictionary.find(key);
+        return value == nullptr ? nullptr : *value;
+    }
+
+    const auto& slot = shape->find(key);
+    if (slot == Shape::npos) {
+        return nullptr;
+    }
+    return slots[slot];
+}
+
+void ObjectValue::insert(const u32string& key, const Datum& value) {
+    if (shape == nullptr) {
+        dictionary.insert(key, Dictionary::hash(key), value);
+        return;
+    }
+
+    const auto& slot = shape->find(key);
+    if (slot != Shape::npos) {
+        slots[slot] = value;
+        return;
+    }
+
+    unshape();
+    dictionary.insert(key, Dictionary::hash(key), value);
+}
+
+void ObjectValue::insert(const StringValue& key, const Datum& value) {
+    const auto existing = shape == nullptr ? dictionary.find(key) : nullptr;
+    if (existing != nullptr) {
+        *existing = value;
+        return;
+    }
+
+    if (shape != nullptr) {
+        const auto& slot = shape->find(key);
+        if (slot != Shape::npos) {
+            slots[slot] = value;
+            return;
+        }
+    }
+
+    insert(key.toUTF32(), value);
+}
+
+void ObjectValue::erase(const u32string& key) {
+    if (shape == nullptr) {
+        dictionary.erase(key, Dictionary::hash(key));
+        return;
+    }
+
+    if (shape->find(key) == Shape::npos) {
+        return;
+    }
+
+    unshape();
+    dictionary.erase(key, Dictionary::hash(key));
+}
+
+void ObjectValue::unshape() {
+    const auto& keys = shape->getKeys();
+    for (decltype(keys.size()) i = 0; i < keys.size(); ++i) {
+        dictionary.insert(keys[i], Dictionary::hash(keys[i]), slots[i]);
+    }
+    shape = nullptr;
+    vector<Datum>().swap(slots);
+}
+
+const u32string& ObjectValue::keyAt(const unsigned long long& index) const {
+    return shape == nullptr ? dictionary.keyAt(index) : shape->getKeys()[index];
+}
+
+const Datum& ObjectValue::valueAt(const unsigned long long& index) const {
+    return shape == nullptr ? dictionary.valueAt(index) : slots[index];
+}
+
+std::string StringValue::UTF32toUTF8(const std::u32string& s) {
+    return Utf8::encode(s.data(), s.size());
+}
+
+std::u32string StringValue::UTF8toUTF32(const std::string& s) {
+    return Utf8::decode(s.data(), s.size());
+}
+
+std::shared_ptr<StringValue> StringValue::create(const char32_t& c) {
+    /* strings are never modified, so they can be shared freely */
+    static map<char32_t, shared_ptr<StringValue>> cache;
+
+    auto& result = cache[c];
+    if (!result) {
+        result = make_shared<StringValue>(u32string(1, c));
+    }
+    return result;
+}
+
+const unsigned long long StringValue::threshold;
+
+StringValue::StringValue() : Value(Type::STRING), storage(), length(0), width(1), ascii(true), lhs(), rhs(), hash(0) {
 }
 
-ArrayValue::ArrayValue() : values() {
+StringValue::StringValue(const u32string& value) : Value(Type::STRING), storage(), length(value.size()), width(1), ascii(true), lhs(), rhs(), hash(0) {
+    for (const auto& c : value) {
+        ascii = ascii && c < 0x80;
+        width = max(width, (unsigned char) (c < 0x100 ? 1 : c < 0x10000 ? 2 : 4));
+    }
+
+    storage.resize(value.size() * width);
+    for (decltype(value.size()) i = 0; i < value.size(); ++i) {
+        switch (width) {
+        case 1:
+            storage[i] = (char) value[i];
+            break;
+        case 2: {
+            const auto c = (char16_t) value[i];
+            memcpy(&storage[i * 2], &c, 2);
+            break;
+        }
+        default:
+            memcpy(&storage[i * 4], &value[i], 4);
+            break;
+        }
+    }
 }
 
-ArrayValue::ArrayValue(const vector<std::shared_ptr<Value>>& values) : values(values.begin(), values.end()) {
+StringValue::StringValue(shared_ptr<StringValue> lhs, shared_ptr<StringValue> rhs) : Value(Type::STRING), storage(), length(lhs->length + rhs->length), width(max(lhs->width, rhs->width)), ascii(lhs->ascii && rhs->ascii), lhs(move(lhs)), rhs(move(rhs)), hash(0) {
+    if (length < threshold) {
+        flatten();
+    }
 }
 
-BoolValue::BoolValue(const bool& value) : value(value) {
+StringValue::~StringValue() {
+    if (!lhs) {
+        return;
+    }
+
+    /* a string built piece by piece is a long chain of concatenations, release it without recursion */
+    vector<shared_ptr<StringValue>> parts;
+    parts.push_back(move(lhs));
+    parts.push_back(move(rhs));
+    while (!parts.empty()) {
+        auto part = move(parts.back());
+        parts.pop_back();
+        if (part && part.use_count() == 1) {
+            parts.push_back(move(part->lhs));
+            parts.push_back(move(part->rhs));
+        }
+    }
 }
 
-FloatValue::FloatValue(const double& value) : value(value) {
+void StringValue::flatten() const {
+    if (!lhs) {
+        return;
+    }
+
+    storage.reserve(length * width);
+    if (!lhs->lhs && !rhs->lhs) {
+        append(*lhs);
+        append(*rhs);
+    } else {
+        vector<const StringValue*> parts {rhs.get(), lhs.get()};
+        while (!parts.empty()) {
+            const auto part = parts.back();
+            parts.pop_back();
+            if (part->lhs) {
+                parts.push_back(part->rhs.get());
+                parts.push_back(part->lhs.get());
+            } else {
+                append(*part);
+            }
+        }
+    }
+
+    lhs.reset();
+    rhs.reset();
 }
 
-FunctionValue::FunctionValue() : parameters(), statements() {
+void StringValue::append(const StringValue& other) const {
+    if (other.width == width) {
+        storage += other.storage;
+        return;
+    }
+
+    /* widen the characters of the other string */
+    const auto offset = storage.size();
+    storage.resize(offset + other.size() * width);
+    for (unsigned long long i = 0; i < other.size(); ++i) {
+        const auto c = other.at(i);
+        if (width == 2) {
+            const auto narrow = (char16_t) c;
+            memcpy(&storage[offset + i * 2], &narrow, 2);
+        } else {
+            memcpy(&storage[offset + i * 4], &c, 4);
+        }
+    }
 }
 
-FunctionValue::FunctionValue(const std::vector<std::u32string>& parameters, const std::vector<std::shared_ptr<Statement>>& statements) : parameters(parameters.begin(), parameters.end()), statements(statements.begin(), statements.end()) {
+unsigned long long StringValue::size() const {
+    return length;
 }
 
-IntValue::IntValue(const signed long long& value) : value(value) {
+char32_t StringValue::at(const unsigned long long& index) const {
+    flatten();
+    switch (width) {
+    case 1:
+        return (unsigned char) storage[index];
+    case 2: {
+        char16_t c;
+        memcpy(&c, &storage[index * 2], 2);
+        return c;
+    }
+    default: {
+        char32_t c;
+        memcpy(&c, &storage[index * 4], 4);
+        return c;
+    }
+    }
 }
 
-std::shared_ptr<NullValue> NullValue::singleton = make_shared<NullValue>();
+u32string StringValue::toUTF32() const {
+    flatten();
+    u32string result(size(), 0);
+    if (width == 4) {
+        memcpy(&result[0], storage.data(), storage.size());
+        return result;
+    }
 
-ObjectValue::ObjectValue() : values() {
+    for (unsigned long long i = 0; i < result.size(); ++i) {
+        result[i] = at(i);
+    }
+    return result;
 }
 
-ObjectValue::ObjectValue(const map<u32string, shared_ptr<Value>>& values) : values(values.begin(), values.end()) {
+string StringValue::toUTF8() const {
+    flatten();
+    if (ascii) {
+        return storage;
+    }
+    if (width == 1) {
+        return Utf8::encode(reinterpret_cast<const unsigned char*>(storage.data()), storage.size());
+    }
+    if (width == 2) {
+        u16string characters(size(), 0);
+        memcpy(&characters[0], storage.data(), storage.size());
+        return Utf8::encode(characters.data(), characters.size());
+    }
+    return UTF32toUTF8(toUTF32());
 }
 
-std::string StringValue::UTF32toUTF8(const std::u32string& s) {
-    std::wstring_convert<std::codecvt_utf8<char32_t>, char32_t> conv;
-    return conv.to_bytes(s);
+const string* StringValue::getASCII() const {
+    flatten();
+    return ascii ? &storage : nullptr;
 }
 
-std::u32string StringValue::UTF8toUTF32(const std::string& s) {
-    std::wstring_convert<codecvt_utf8<char32_t>, char32_t> conv;
-    return conv.from_bytes(s);
+int StringValue::compare(const u32string& other) const {
+    flatten();
+    for (unsigned long long i = 0; i < length && i < other.size(); ++i) {
+        const auto c = at(i);
+        if (c != other[i]) {
+            return c < other[i] ? -1 : 1;
+        }
+    }
+
+    if (length == other.size()) {
+        return 0;
+    }
+    return length < other.size() ? -1 : 1;
 }
 
-StringValue::StringValue() : value() {
+bool StringValue::equals(const StringValue& other) const {
+    /* the width is the narrowest one the characters fit in, so equal strings have equal widths */
+    if (length != other.length || width != other.width) {
+        return false;
+    }
+
+    flatten();
+    other.flatten();
+    return storage == other.storage;
 }
 
-StringValue::StringValue(const u32string& value) : value(value) {
+size_t StringValue::getHash() const {
+    /* strings are never modified, a zero hash is merely computed again */
+    if (hash == 0) {
+        hash = hashCharacters(*this, size());
+    }
+    return hash;
 }
 
-std::shared_ptr<Value> ArrayValue::walk(ValueWalker& walker) {
+Datum ArrayValue::walk(ValueWalker& walker) {
     return walker.value(*this);
 }
 
-std::shared_ptr<Value> BoolValue::walk(ValueWalker& walker) {
+Datum BoolValue::walk(ValueWalker& walker) {
     return walker.value(*this);
 }
 
-std::shared_ptr<Value> FloatValue::walk(ValueWalker& walker) {
+Datum FloatValue::walk(ValueWalker& walker) {
     return walker.value(*this);
 }
 
-std::shared_ptr<Value> FunctionValue::walk(ValueWalker& walker) {
+Datum FunctionValue::walk(ValueWalker& walker) {
     return walker.value(*this);
 }
 
-std::shared_ptr<Value> IntValue::walk(ValueWalker& walker) {
+Datum IntValue::walk(ValueWalker& walker) {
     return walker.value(*this);
 }
 
-std::shared_ptr<Value> NullValue::walk(ValueWalker& walker) {
+Datum NullValue::walk(ValueWalker& walker) {
     return walker.value(*this);
 }
 
-std::shared_ptr<Value> ObjectValue::walk(ValueWalker& walker) {
+Datum ObjectValue::walk(ValueWalker& walker) {
     return walker.value(*this);
 }
 
-std::shared_ptr<Value> StringValue::walk(ValueWalker& walker) {
+Datum StringValue::walk(ValueWalker& walker) {
     return walker.value(*this);
 }
 
@@ -115,573 +1294,417 @@ bool BoolValue::isTrue() {
     return value;
 }
 
-shared_ptr<Value> Value::doSelect(shared_ptr<Value>) {
+Datum Value::doSelect(const Datum&) {
     return NullValue::singleton;
 }
 
-shared_ptr<Value> ArrayValue::doSelect(shared_ptr<Value> value) {
-    struct Walker : public DefaultValueWalker {
-        Walker(ArrayValue& arrayValue) : arrayValue(arrayValue) {
-        }
+Datum Value::doSelect(InlineCache& cache) {
+    return doSelect(Datum(cache.key));
+}
 
-        shared_ptr<Value> value(IntValue& node) {
-            if (node.value >= 0 && (unsigned long long) node.value < arrayValue.values.size()) {
-                return arrayValue.values[node.value];
-            }
-            return NullValue::singleton;
+Datum ArrayValue::doSelect(const Datum& index) {
+    if (index.getTag() == Datum::Tag::INT) {
+        const auto& i = index.getInt();
+        if (i >= 0 && (unsigned long long) i < to - from) {
+            return (*storage)[from + i];
         }
+    }
+    return NullValue::singleton;
+}
 
-        ArrayValue& arrayValue;
-    } walker(*this);
-    return value->walk(walker);
+Datum RangeValue::doSelect(const Datum& index) {
+    if (index.getTag() == Datum::Tag::INT) {
+        const auto& i = index.getInt();
+        if (i >= 0 && (unsigned long long) i < count) {
+            return Datum(at(i));
+        }
+    }
+    return NullValue::singleton;
 }
 
-shared_ptr<Value> ObjectValue::doSelect(shared_ptr<Value> value) {
+Datum ObjectValue::doSelect(const Datum& value) {
     struct Walker : public DefaultValueWalker {
         Walker(ObjectValue& objectValue) : objectValue(objectValue) {
         }
 
-        shared_ptr<Value> value(StringValue& node) {
-            auto iterator = objectValue.values.find(node.value);
-            if (iterator != objectValue.values.end()) {
-                return iterator->second;
+        Datum value(StringValue& node) {
+            const auto& value = objectValue.find(node);
+            if (!value.isEmpty()) {
+                return value;
             }
             return NullValue::singleton;
         }
 
         ObjectValue& objectValue;
     } walker(*this);
-    return value->walk(walker);
+    return value.walk(walker);
 }
 
-shared_ptr<Value> StringValue::doSelect(shared_ptr<Value> value) {
-    struct Walker : public DefaultValueWalker {
-        Walker(StringValue& stringValue) : stringValue(stringValue) {
-        }
+Datum ObjectValue::doSelect(InlineCache& cache) {
+    if (shape == nullptr) {
+        const auto& value = find(*cache.key);
+        return value.isEmpty() ? NullValue::singleton : value;
+    }
 
-        shared_ptr<Value> value(IntValue& node) {
-            if (node.value >= 0 && (unsigned long long) node.value < stringValue.value.size()) {
-                return make_shared<StringValue>(u32string(1, stringValue.value[node.value]));
-            }
-            return NullValue::singleton;
+    for (unsigned i = 0; i < cache.count && i < InlineCache::size; ++i) {
+        if (cache.shapes[i] == shape) {
+            return cache.slots[i] == Shape::npos ? NullValue::singleton : slots[cache.slots[i]];
         }
+    }
 
-        StringValue& stringValue;
-    } walker(*this);
-    return value->walk(walker);
-}
+    const auto& slot = shape->find(*cache.key);
+    if (cache.count < InlineCache::size) {
+        cache.shapes[cache.count] = shape;
+        cache.slots[cache.count] = slot;
+        ++cache.count;
+    }
 
-shared_ptr<Value> Value::doUnary(const UnaryOperator&) {
-    return NullValue::singleton;
+    return slot == Shape::npos ? NullValue::singleton : slots[slot];
 }
 
-shared_ptr<Value> BoolValue::doUnary(const UnaryOperator& oper) {
-    if (oper == UnaryOperator::NOT) {
-        return make_shared<BoolValue>(!value);
+Datum StringValue::doSelect(const Datum& index) {
+    if (index.getTag() == Datum::Tag::INT) {
+        const auto& i = index.getInt();
+        if (i >= 0 && (unsigned long long) i < size()) {
+            return StringValue::create(at(i));
+        }
     }
-
     return NullValue::singleton;
 }
 
-shared_ptr<Value> FloatValue::doUnary(const UnaryOperator& oper) {
-    if (oper == UnaryOperator::NEG) {
-        return make_shared<FloatValue>(-value);
-    }
-
+Datum Value::doCall(Program&, vector<Datum>&) {
     return NullValue::singleton;
 }
 
-shared_ptr<Value> IntValue::doUnary(const UnaryOperator& oper) {
-    if (oper == UnaryOperator::NEG) {
-        return make_shared<IntValue>(-value);
+Datum FunctionValue::doCall(Program& scope, vector<Datum>& values) {
+    Frame frame{*this, {}, false};
+    if (layout) {
+        scope.enter(*layout, layout->reusable ? &frame : nullptr);
     }
 
-    return NullValue::singleton;
-}
+    for (decltype(parameters.size()) i = 0; i < parameters.size(); ++i) {
+        const auto value = i < values.size() ? values[i] : Datum(NullValue::singleton);
+        if (layout) {
+            scope.defineVariable({0, layout->parameters[i], true, 0}, parameters[i], value);
+        } else {
+            scope.insertVariable(parameters[i], value);
+        }
+    }
 
-shared_ptr<Value> Value::doBinary(const BinaryOperator&, shared_ptr<Value>) {
-    return NullValue::singleton;
+    /* a tail call of this function starts over with the new arguments, see Frame */
+    for (;;) {
+        const auto returnValue = run(scope);
+        if (!frame.pending) {
+            return returnValue;
+        }
+
+        frame.pending = false;
+        for (decltype(parameters.size()) i = 0; i < parameters.size(); ++i) {
+            const auto value = i < frame.arguments.size() ? frame.arguments[i] : Datum(NullValue::singleton);
+            scope.writeVariable({0, layout->parameters[i], true, 0}, parameters[i], value);
+        }
+    }
 }
 
-shared_ptr<Value> ArrayValue::doBinary(const BinaryOperator& oper, shared_ptr<Value> rhs) {
-    /* add element */
-    if (oper == BinaryOperator::ADD) {
-        auto result = make_shared<ArrayValue>();
-        result->values.insert(result->values.begin(), values.begin(), values.end());
-        result->values.push_back(rhs);
-        return result;
+Datum FunctionValue::run(Program& scope) {
+    if (!chunk && scope.isJit() && ++calls == Jit::threshold) {
+        chunk = Compiler::compile(parameters, statements, layout);
+        chunk->hotness = Jit::threshold;
+        chunk->native = Jit::compile(*chunk);
     }
 
-    /* remove element */
-    if (oper == BinaryOperator::SUB) {
-        auto result = make_shared<ArrayValue>();
-        for (auto& value : values) {
-            if (!value->doBinary(BinaryOperator::EQU, rhs)->isTrue()) {
-                result->values.push_back(value);
-            }
+    if (chunk) {
+        Machine machine(scope, *chunk);
+        const auto& returnValue = machine();
+        return !returnValue.isEmpty() ? returnValue : NullValue::singleton;
+    }
+
+    for (auto& statement : statements) {
+        const auto& returnValue = statement->walk(scope);
+        if (!returnValue.isEmpty()) {
+            return returnValue;
         }
-        return result;
     }
 
     return NullValue::singleton;
 }
 
-shared_ptr<Value> BoolValue::doBinary(const BinaryOperator& oper, shared_ptr<Value> rhs) {
-    struct Walker : public DefaultValueWalker {
-        Walker(BoolValue& lhs, const BinaryOperator& oper) : lhs(lhs), oper(oper) {
-        }
-
-        shared_ptr<Value> value(BoolValue& rhs) {
-            switch (oper) {
-            case BinaryOperator::AND:
-                return make_shared<BoolValue>(lhs.value && rhs.value);
-            case BinaryOperator::OR:
-                return make_shared<BoolValue>(lhs.value || rhs.value);
-            case BinaryOperator::EQU:
-                return make_shared<BoolValue>(lhs.value == rhs.value);
-            case BinaryOperator::NEQ:
-                return make_shared<BoolValue>(lhs.value != rhs.value);
-            default:
-                return NullValue::singleton;
-            }
-        }
+void Value::doModify(const Datum&, const Datum&) {
+}
+
+void Value::doModify(InlineCache& cache, const Datum& value) {
+    doModify(Datum(cache.key), value);
+}
 
-        BoolValue& lhs;
-        BinaryOperator oper;
-    } walker(*this, oper);
-    return rhs->walk(walker);
+void ArrayValue::doModify(const Datum& index, const Datum& value) {
+    if (index.getTag() == Datum::Tag::INT) {
+        const auto& i = index.getInt();
+        if (i >= 0 && (unsigned long long) i < to - from) {
+            own();
+            (*storage)[from + i] = value;
+        }
+    }
 }
 
-shared_ptr<Value> FloatValue::doBinary(const BinaryOperator& oper, shared_ptr<Value> rhs) {
+void ObjectValue::doModify(const Datum& index, const Datum& value) {
     struct Walker : public DefaultValueWalker {
-        Walker(FloatValue& lhs, const BinaryOperator& oper) : lhs(lhs), oper(oper) {
-        }
-
-        shared_ptr<Value> value(FloatValue& rhs) {
-            switch (oper) {
-            case BinaryOperator::ADD:
-                return make_shared<FloatValue>(lhs.value + rhs.value);
-            case BinaryOperator::SUB:
-                return make_shared<FloatValue>(lhs.value - rhs.value);
-            case BinaryOperator::MUL:
-                return make_shared<FloatValue>(lhs.value * rhs.value);
-            case BinaryOperator::DIV:
-                if (rhs.value != 0.0) {
-                    return make_shared<FloatValue>(lhs.value / rhs.value);
-                }
-                break;
-            case BinaryOperator::EQU:
-                return make_shared<BoolValue>(lhs.value == rhs.value);
-            case BinaryOperator::NEQ:
-                return make_shared<BoolValue>(lhs.value != rhs.value);
-            case BinaryOperator::LES:
-                return make_shared<BoolValue>(lhs.value < rhs.value);
-            case BinaryOperator::LEQ:
-                return make_shared<BoolValue>(lhs.value <= rhs.value);
-            case BinaryOperator::GRT:
-                return make_shared<BoolValue>(lhs.value > rhs.value);
-            case BinaryOperator::GEQ:
-                return make_shared<BoolValue>(lhs.value >= rhs.value);
-            default:
-                break;
-            }
-            return NullValue::singleton;
+        Walker(ObjectValue& object, const Datum& newValue) : object(object), newValue(newValue) {
         }
 
-        shared_ptr<Value> value(IntValue& rhs) {
-            switch (oper) {
-            case BinaryOperator::ADD:
-                return make_shared<FloatValue>(lhs.value + rhs.value);
-            case BinaryOperator::SUB:
-                return make_shared<FloatValue>(lhs.value - rhs.value);
-            case BinaryOperator::MUL:
-                return make_shared<FloatValue>(lhs.value * rhs.value);
-            case BinaryOperator::DIV:
-                if (rhs.value != 0) {
-                    return make_shared<FloatValue>(lhs.value / rhs.value);
-                }
-                break;
-            case BinaryOperator::LES:
-                return make_shared<BoolValue>(lhs.value < rhs.value);
-            case BinaryOperator::LEQ:
-                return make_shared<BoolValue>(lhs.value <= rhs.value);
-            case BinaryOperator::GRT:
-                return make_shared<BoolValue>(lhs.value > rhs.value);
-            case BinaryOperator::GEQ:
-                return make_shared<BoolValue>(lhs.value >= rhs.value);
-            default:
-                break;
-            }
+        Datum value(StringValue& index) {
+            object.insert(index, newValue);
             return NullValue::singleton;
         }
 
-        FloatValue& lhs;
-        BinaryOperator oper;
-    } walker(*this, oper);
-    return rhs->walk(walker);
-}
-
-shared_ptr<Value> FunctionValue::doBinary(const BinaryOperator&, shared_ptr<Value>) {
-    return NullValue::singleton;
+        ObjectValue& object;
+        const Datum& newValue;
+    } walker(*this, value);
+    index.walk(walker);
 }
 
-shared_ptr<Value> IntValue::doBinary(const BinaryOperator& oper, shared_ptr<Value> rhs) {
-    struct Walker : public DefaultValueWalker {
-        Walker(IntValue& lhs, const BinaryOperator& oper) : lhs(lhs), oper(oper) {
-        }
-
-        shared_ptr<Value> value(FloatValue& rhs) {
-            switch (oper) {
-            case BinaryOperator::ADD:
-                return make_shared<FloatValue>(lhs.value + rhs.value);
-            case BinaryOperator::SUB:
-                return make_shared<FloatValue>(lhs.value - rhs.value);
-            case BinaryOperator::MUL:
-                return make_shared<FloatValue>(lhs.value * rhs.value);
-            case BinaryOperator::DIV:
-                if (rhs.value != 0.0) {
-                    return make_shared<FloatValue>(lhs.value / rhs.value);
-                }
-                break;
-            case BinaryOperator::LES:
-                return make_shared<BoolValue>(lhs.value < rhs.value);
-            case BinaryOperator::LEQ:
-                return make_shared<BoolValue>(lhs.value <= rhs.value);
-            case BinaryOperator::GRT:
-                return make_shared<BoolValue>(lhs.value > rhs.value);
-            case BinaryOperator::GEQ:
-                return make_shared<BoolValue>(lhs.value >= rhs.value);
-            default:
-                break;
-            }
-            return NullValue::singleton;
-        }
-
-        shared_ptr<Value> value(IntValue& rhs) {
-            switch (oper) {
-            case BinaryOperator::ADD:
-                return make_shared<IntValue>(lhs.value + rhs.value);
-            case BinaryOperator::SUB:
-                return make_shared<IntValue>(lhs.value - rhs.value);
-            case BinaryOperator::MUL:
-                return make_shared<IntValue>(lhs.value * rhs.value);
-            case BinaryOperator::DIV:
-                if (rhs.value != 0) {
-                    return make_shared<IntValue>(lhs.value / rhs.value);
-                }
-                break;
-            case BinaryOperator::MOD:
-                if (rhs.value != 0) {
-                    return make_shared<IntValue>(lhs.value % rhs.value);
-                }
-                break;
-            case BinaryOperator::EQU:
-                return make_shared<BoolValue>(lhs.value == rhs.value);
-            case BinaryOperator::NEQ:
-                return make_shared<BoolValue>(lhs.value != rhs.value);
-            case BinaryOperator::LES:
-                return make_shared<BoolValue>(lhs.value < rhs.value);
-            case BinaryOperator::LEQ:
-                return make_shared<BoolValue>(lhs.value <= rhs.value);
-            case BinaryOperator::GRT:
-                return make_shared<BoolValue>(lhs.value > rhs.value);
-            case BinaryOperator::GEQ:
-                return make_shared<BoolValue>(lhs.value >= rhs.value);
-            default:
-                break;
-            }
-            return NullValue::singleton;
+void ObjectValue::doModify(InlineCache& cache, const Datum& value) {
+    for (unsigned i = 0; i < cache.count && i < InlineCache::size; ++i) {
+        if (cache.shapes[i] == shape && cache.slots[i] != Shape::npos) {
+            slots[cache.slots[i]] = value;
+            return;
         }
+    }
 
-        IntValue& lhs;
-        BinaryOperator oper;
-    } walker(*this, oper);
-    return rhs->walk(walker);
+    insert(*cache.key, value);
+    if (shape != nullptr && cache.count < InlineCache::size) {
+        cache.shapes[cache.count] = shape;
+        cache.slots[cache.count] = shape->find(*cache.key);
+        ++cache.count;
+    }
 }
 
-shared_ptr<Value> NullValue::doBinary(const BinaryOperator&, shared_ptr<Value>) {
-    return NullValue::singleton;
+bool ArrayValue::doAppend(const Datum& value) {
+    own();
+
+    /* the storage is this array's own, but may still hold the elements of a longer slice */
+    storage->erase(storage->begin() + to, storage->end());
+    storage->push_back(value);
+    ++to;
+    return true;
 }
 
-shared_ptr<Value> ObjectValue::doBinary(const BinaryOperator& oper, shared_ptr<Value> rhs) {
-    struct Walker : public DefaultValueWalker {
-        Walker(ObjectValue& lhs, const BinaryOperator& oper) : lhs(lhs), oper(oper) {
-        }
+bool RangeValue::doAppend(const Datum&) {
+    return false;
+}
 
-        shared_ptr<Value> value(StringValue& rhs) {
-            if (oper == BinaryOperator::SUB) {
-                auto returnValue = make_shared<ObjectValue>(lhs.values);
-                returnValue->values.erase(rhs.value);
-                return returnValue;
-            }
-            return NullValue::singleton;
-        }
+unsigned long long Value::getLength() {
+    return 0;
+}
 
-        shared_ptr<Value> value(ObjectValue& rhs) {
-            auto returnValue = make_shared<ObjectValue>(lhs.values);
+unsigned long long ArrayValue::getLength() {
+    return to - from;
+}
 
-            switch (oper) {
-            case BinaryOperator::AND:
-                for (const auto& key : rhs.values) {
-                    if (returnValue->values.find(key.first) == returnValue->values.end()) {
-                        returnValue->values.erase(key.first);
-                    }
-                }
-                return returnValue;
+unsigned long long RangeValue::getLength() {
+    return count;
+}
 
-            case BinaryOperator::OR:
-                for (const auto& key : rhs.values) {
-                    if (returnValue->values.find(key.first) == returnValue->values.end()) {
-                        returnValue->values[key.first] = key.second;
-                    }
-                }
-                return returnValue;
+unsigned long long ObjectValue::getLength() {
+    return shape == nullptr ? dictionary.size() : slots.size();
+}
 
-            case BinaryOperator::EQU:
-                if (lhs.values.size() != rhs.values.size()) {
-                    return make_shared<BoolValue>(false);
-                }
+unsigned long long StringValue::getLength() {
+    return size();
+}
 
-                for (const auto& key : rhs.values) {
-                    const auto& value = lhs.values.find(key.first);
+Datum Value::getKey(const unsigned long long&) {
+    return NullValue::singleton;
+}
 
-                    if (value == lhs.values.end()) {
-                        return make_shared<BoolValue>(false);
-                    }
+Datum ArrayValue::getKey(const unsigned long long& index) {
+    return Datum((signed long long) index);
+}
 
-                    if (!value->second->doBinary(BinaryOperator::EQU, key.second)->isTrue()) {
-                        return make_shared<BoolValue>(false);
-                    }
-                }
+Datum RangeValue::getKey(const unsigned long long& index) {
+    return Datum((signed long long) index);
+}
 
-                return make_shared<BoolValue>(true);
+Datum ObjectValue::getKey(const unsigned long long& index) {
+    if (index < getLength()) {
+        return make_shared<StringValue>(keyAt(index));
+    }
+    return NullValue::singleton;
+}
 
-            case BinaryOperator::NEQ:
-                if (lhs.values.size() != rhs.values.size()) {
-                    return make_shared<BoolValue>(true);
-                }
+Datum StringValue::getKey(const unsigned long long& index) {
+    return Datum((signed long long) index);
+}
 
-                for (const auto& key : rhs.values) {
-                    const auto& value = lhs.values.find(key.first);
+Datum Value::getValue(const unsigned long long&) {
+    return NullValue::singleton;
+}
 
-                    if (value == lhs.values.end()) {
-                        return make_shared<BoolValue>(true);
-                    }
+Datum ArrayValue::getValue(const unsigned long long& index) {
+    if (index < to - from) {
+        return (*storage)[from + index];
+    }
+    return NullValue::singleton;
+}
 
-                    if (!value->second->doBinary(BinaryOperator::NEQ, key.second)->isTrue()) {
-                        return make_shared<BoolValue>(true);
-                    }
-                }
+Datum RangeValue::getValue(const unsigned long long& index) {
+    if (index < count) {
+        return Datum(at(index));
+    }
+    return NullValue::singleton;
+}
 
-                return make_shared<BoolValue>(false);
+Datum ObjectValue::getValue(const unsigned long long& index) {
+    if (index < getLength()) {
+        return valueAt(index);
+    }
+    return NullValue::singleton;
+}
 
-            default:
-                break;
-            }
-            return NullValue::singleton;
-        }
+Datum StringValue::getValue(const unsigned long long& index) {
+    if (index < size()) {
+        return StringValue::create(at(index));
+    }
 
-        ObjectValue& lhs;
-        BinaryOperator oper;
-    } walker(*this, oper);
-    return rhs->walk(walker);
+    return NullValue::singleton;
 }
 
-shared_ptr<Value> StringValue::doBinary(const BinaryOperator& oper, shared_ptr<Value> rhs) {
-    struct Walker : public ValueWalker {
-        Walker(StringValue& lhs, const BinaryOperator& oper) : lhs(lhs), oper(oper) {
-        }
+Cursor::~Cursor() {
+}
 
-        shared_ptr<Value> value(ArrayValue&) {
-            if (oper == BinaryOperator::ADD) {
-                return make_shared<StringValue>(lhs.value + U"Array");
-            }
-            return NullValue::singleton;
-        }
+unique_ptr<Cursor> Datum::iterate() const {
+    if (tag == Tag::BOXED) {
+        return boxed->iterate();
+    }
 
-        shared_ptr<Value> value(BoolValue& rhs) {
-            if (oper == BinaryOperator::ADD) {
-                return make_shared<StringValue>(lhs.value + (rhs.value ? U"true" : U"false"));
-            }
-            return NullValue::singleton;
+    struct Empty : public Cursor {
+        bool next() {
+            return false;
         }
 
-        shared_ptr<Value> value(FloatValue& rhs) {
-            if (oper == BinaryOperator::ADD) {
-                return make_shared<StringValue>(lhs.value + StringValue::UTF8toUTF32(to_string(rhs.value)));
-            }
+        Datum getKey() {
             return NullValue::singleton;
         }
 
-        shared_ptr<Value> value(FunctionValue&) {
-            if (oper == BinaryOperator::ADD) {
-                return make_shared<StringValue>(lhs.value + U"Function");
-            }
+        Datum getValue() {
             return NullValue::singleton;
         }
+    };
+    return unique_ptr<Cursor>(new Empty());
+}
 
-        shared_ptr<Value> value(IntValue& rhs) {
-            if (oper == BinaryOperator::ADD) {
-                return make_shared<StringValue>(lhs.value + StringValue::UTF8toUTF32(to_string(rhs.value)));
-            }
-            return NullValue::singleton;
+unique_ptr<Cursor> Value::iterate() {
+    struct Indexed : public Cursor {
+        Indexed(Value& value) : value(value), index(-1) {
         }
 
-        shared_ptr<Value> value(NullValue&) {
-            if (oper == BinaryOperator::ADD) {
-                return make_shared<StringValue>(lhs.value + U"null");
-            }
-            return NullValue::singleton;
+        bool next() {
+            return ++index < value.getLength();
         }
 
-        shared_ptr<Value> value(ObjectValue&) {
-            if (oper == BinaryOperator::ADD) {
-                return make_shared<StringValue>(lhs.value + U"Object");
-            }
-            return NullValue::singleton;
+        Datum getKey() {
+            return value.getKey(index);
         }
 
-        shared_ptr<Value> value(StringValue& rhs) {
-            switch (oper) {
-            case BinaryOperator::ADD:
-                return make_shared<StringValue>(lhs.value + rhs.value);
-            case BinaryOperator::EQU:
-                return make_shared<BoolValue>(lhs.value == rhs.value);
-            case BinaryOperator::NEQ:
-                return make_shared<BoolValue>(lhs.value != rhs.value);
-            default:
-                break;
-            }
-            return NullValue::singleton;
+        Datum getValue() {
+            return value.getValue(index);
         }
 
-        StringValue& lhs;
-        BinaryOperator oper;
-    } walker(*this, oper);
-    return rhs->walk(walker);
-}
-
-shared_ptr<Value> Value::doCall(Program&, vector<shared_ptr<Value>>&) {
-    return NullValue::singleton;
+        Value& value;
+        unsigned long long index;
+    };
+    return unique_ptr<Cursor>(new Indexed(*this));
 }
 
-shared_ptr<Value> FunctionValue::doCall(Program& scope, vector<shared_ptr<Value>>& values) {
-    for (decltype(parameters.size()) i = 0; i < parameters.size(); ++i) {
-        scope.insertVariable(parameters[i], i < values.size() ? values[i] : NullValue::singleton);
-    }
-
-    for (auto& statement : statements) {
-        const auto& returnValue = statement->walk(scope);
-        if (returnValue != nullptr) {
-            return returnValue;
+unique_ptr<Cursor> ArrayValue::iterate() {
+    struct Elements : public Cursor {
+        Elements(ArrayValue& array) : array(array), index(-1) {
         }
-    }
 
-    return NullValue::singleton;
-}
-
-void Value::doModify(shared_ptr<Value>, shared_ptr<Value>) {
-}
+        bool next() {
+            return ++index < array.to - array.from;
+        }
 
-void ArrayValue::doModify(shared_ptr<Value> index, shared_ptr<Value> value) {
-    struct Walker : public DefaultValueWalker {
-        Walker(ArrayValue& array, shared_ptr<Value> newValue) : array(array), newValue(newValue) {
+        Datum getKey() {
+            return Datum((signed long long) index);
         }
 
-        shared_ptr<Value> value(IntValue& index) {
-            if (index.value >= 0 && (unsigned long long) index.value < array.values.size()) {
-                array.values[index.value] = newValue;
-            }
-            return NullValue::singleton;
+        Datum getValue() {
+            return (*array.storage)[array.from + index];
         }
 
         ArrayValue& array;
-        shared_ptr<Value> newValue;
-    } walker(*this, value);
-    index->walk(walker);
+        unsigned long long index;
+    };
+    return unique_ptr<Cursor>(new Elements(*this));
 }
 
-void ObjectValue::doModify(shared_ptr<Value> index, shared_ptr<Value> value) {
-    struct Walker : public DefaultValueWalker {
-        Walker(ObjectValue& object, shared_ptr<Value> newValue) : object(object), newValue(newValue) {
+unique_ptr<Cursor> RangeValue::iterate() {
+    struct Numbers : public Cursor {
+        Numbers(RangeValue& range) : range(range), index(-1) {
         }
 
-        shared_ptr<Value> value(StringValue& index) {
-            object.values[index.value] = newValue;
-            return NullValue::singleton;
+        bool next() {
+            return ++index < range.count;
         }
 
-        ObjectValue& object;
-        shared_ptr<Value> newValue;
-    } walker(*this, value);
-    index->walk(walker);
-}
-
-unsigned long long Value::getLength() {
-    return 0;
-}
-
-unsigned long long ArrayValue::getLength() {
-    return values.size();
-}
-
-unsigned long long ObjectValue::getLength() {
-    return values.size();
-}
+        Datum getKey() {
+            return Datum((signed long long) index);
+        }
 
-unsigned long long StringValue::getLength() {
-    return value.size();
-}
+        Datum getValue() {
+            return Datum(range.at(index));
+        }
 
-shared_ptr<Value> Value::getKey(const unsigned long long&) {
-    return NullValue::singleton;
+        RangeValue& range;
+        unsigned long long index;
+    };
+    return unique_ptr<Cursor>(new Numbers(*this));
 }
 
-shared_ptr<Value> ArrayValue::getKey(const unsigned long long& index) {
-    return make_shared<IntValue>(index);
-}
+unique_ptr<Cursor> ObjectValue::iterate() {
+    struct Entries : public Cursor {
+        Entries(ObjectValue& object) : object(object), index(-1) {
+        }
 
-shared_ptr<Value> ObjectValue::getKey(const unsigned long long& index) {
-    auto iterator = values.begin();
-    std::advance(iterator, index);
+        bool next() {
+            return ++index < object.getLength();
+        }
 
-    if (iterator != values.end()) {
-        return make_shared<StringValue>(iterator->first);
-    }
-    return NullValue::singleton;
-}
+        Datum getKey() {
+            return make_shared<StringValue>(object.keyAt(index));
+        }
 
-shared_ptr<Value> StringValue::getKey(const unsigned long long& index) {
-    return make_shared<IntValue>(index);
-}
+        Datum getValue() {
+            return object.valueAt(index);
+        }
 
-shared_ptr<Value> Value::getValue(const unsigned long long&) {
-    return NullValue::singleton;
+        ObjectValue& object;
+        unsigned long long index;
+    };
+    return unique_ptr<Cursor>(new Entries(*this));
 }
 
-shared_ptr<Value> ArrayValue::getValue(const unsigned long long& index) {
-    if (index < values.size()) {
-        return values[index];
-    }
-    return NullValue::singleton;
-}
+unique_ptr<Cursor> StringValue::iterate() {
+    struct Characters : public Cursor {
+        Characters(StringValue& string) : string(string), index(-1) {
+        }
 
-shared_ptr<Value> ObjectValue::getValue(const unsigned long long& index) {
-    auto iterator = values.begin();
-    std::advance(iterator, index);
+        bool next() {
+            return ++index < string.size();
+        }
 
-    if (iterator != values.end()) {
-        return iterator->second;
-    }
-    return NullValue::singleton;
-}
+        Datum getKey() {
+            return Datum((signed long long) index);
+        }
 
-shared_ptr<Value> StringValue::getValue(const unsigned long long& index) {
-    if (index < value.size()) {
-        return make_shared<StringValue>(u32string(1, value[index]));
-    }
+        Datum getValue() {
+            return StringValue::create(string.at(index));
+        }
 
-    return NullValue::singleton;
+        StringValue& string;
+        unsigned long long index;
+    };
+    return unique_ptr<Cursor>(new Characters(*this));
 }
 
 ValueWalker::~ValueWalker() {
@@ -690,35 +1713,35 @@ ValueWalker::~ValueWalker() {
 DefaultValueWalker::~DefaultValueWalker() {
 }
 
-std::shared_ptr<Value> DefaultValueWalker::value(ArrayValue&) {
+Datum DefaultValueWalker::value(ArrayValue&) {
     return NullValue::singleton;
 }
 
-std::shared_ptr<Value> DefaultValueWalker::value(BoolValue&) {
+Datum DefaultValueWalker::value(BoolValue&) {
     return NullValue::singleton;
 }
 
-std::shared_ptr<Value> DefaultValueWalker::value(FloatValue&) {
+Datum DefaultValueWalker::value(FloatValue&) {
     return NullValue::singleton;
 }
 
-std::shared_ptr<Value> DefaultValueWalker::value(FunctionValue&) {
+Datum DefaultValueWalker::value(FunctionValue&) {
     return NullValue::singleton;
 }
 
-std::shared_ptr<Value> DefaultValueWalker::value(IntValue&) {
+Datum DefaultValueWalker::value(IntValue&) {
     return NullValue::singleton;
 }
 
-std::shared_ptr<Value> DefaultValueWalker::value(NullValue&) {
+Datum DefaultValueWalker::value(NullValue&) {
     return NullValue::singleton;
 }
 
-std::shared_ptr<Value> DefaultValueWalker::value(ObjectValue&) {
+Datum DefaultValueWalker::value(ObjectValue&) {
     return NullValue::singleton;
 }
 
-std::shared_ptr<Value> DefaultValueWalker::value(StringValue&) {
+Datum DefaultValueWalker::value(StringValue&) {
     return NullValue::singleton;
 }
 
@@ -19,6 +19,8 @@
 #ifndef VALUE_H_
 #define VALUE_H_
 
+#include "Expression.h"
+
 #include <map>
 #include <memory>
 #include <string>
@@ -26,147 +28,665 @@
 
 namespace noumenon {
 
+class Cursor;
 class Program;
+struct Chunk;
+struct InlineCache;
+struct Layout;
 struct Statement;
-enum class BinaryOperator;
-enum class UnaryOperator;
 
+struct StringValue;
+struct Value;
 class ValueWalker;
 
+/* type of a value, as used to look up operations */
+enum class Type : unsigned char {
+    NUL,
+    BOOL,
+    INT,
+    FLOAT,
+    ARRAY,
+    FUNCTION,
+    OBJECT,
+    STRING
+};
+
+/*
+ * A value as handled by the interpreter. Null, booleans, integers and floating
+ * point numbers are stored inline, everything else is a reference to a heap
+ * allocated Value. The Value classes of the scalars still exist: walking a
+ * scalar walks a temporary instance and box() creates a heap allocated one for
+ * code that needs a shared pointer.
+ */
+class Datum {
+public:
+    enum class Tag : unsigned char {
+        EMPTY,  /* no value, e.g. an undefined variable or a missing return */
+        NUL,
+        BOOL,
+        INT,
+        FLOAT,
+        BOXED
+    };
+
+    Datum();
+    Datum(std::nullptr_t);
+    template<typename T>
+    Datum(std::shared_ptr<T> value) : tag(Tag::EMPTY), integer(0) {
+        unbox(std::move(value));
+    }
+    explicit Datum(const bool&);
+    explicit Datum(const signed long long&);
+    explicit Datum(const double&);
+    Datum(const Datum&);
+    Datum(Datum&&);
+    ~Datum();
+
+    Datum& operator=(const Datum&);
+    Datum& operator=(Datum&&);
+
+    Tag getTag() const;
+    Type getType() const;
+    bool isEmpty() const;
+    bool getBool() const;
+    signed long long getInt() const;
+    double getFloat() const;
+    const std::shared_ptr<Value>& getBoxed() const;
+    std::shared_ptr<Value> box() const;
+
+    Datum walk(ValueWalker&) const;
+    bool isTrue() const;
+
+    /* operations on scalars, shared by all engines */
+    static Datum unaryBool(const UnaryOperator&, const bool&);
+    static Datum unaryInt(const UnaryOperator&, const signed long long&);
+    static Datum unaryFloat(const UnaryOperator&, const double&);
+    static Datum binaryBool(const BinaryOperator&, const bool&, const bool&);
+    static Datum binaryInt(const BinaryOperator&, const signed long long&, const signed long long&);
+
+    /* integers mixed with floating point numbers cannot be tested for equality */
+    static Datum binaryFloat(const BinaryOperator&, const double&, const double&, const bool& mixed);
+
+    Datum doSelect(const Datum&) const;
+    Datum doSelect(InlineCache&) const;
+    Datum doUnary(const UnaryOperator&) const;
+    Datum doBinary(const BinaryOperator&, const Datum&) const;
+    Datum doCall(Program&, std::vector<Datum>&) const;
+    void doModify(const Datum& index, const Datum& value) const;
+    void doModify(InlineCache&, const Datum& value) const;
+    unsigned long long getLength() const;
+    Datum getKey(const unsigned long long&) const;
+    Datum getValue(const unsigned long long&) const;
+    std::unique_ptr<Cursor> iterate() const;
+
+private:
+    /* native code reads and writes scalars directly */
+    friend class Jit;
+
+    void unbox(std::shared_ptr<Value>);
+    void assign(const Datum&);
+    void clear();
+
+    Tag tag;
+    union {
+        bool boolean;
+        signed long long integer;
+        double real;
+        std::shared_ptr<Value> boxed;
+    };
+};
+
+/*
+ * Key set of an object literal. All objects created by literals with the same
+ * keys share one shape and store their values in a flat vector, in the order
+ * of the sorted keys. Shapes are never released, so there is one per distinct
+ * key set in the source code only; objects whose keys change at runtime use a
+ * Dictionary instead.
+ */
+class Shape {
+public:
+    static const unsigned npos = static_cast<unsigned>(-1);
+
+    static const Shape* empty();
+    static const Shape* of(const std::vector<std::u32string>& sortedKeys);
+
+    const std::vector<std::u32string>& getKeys() const;
+
+    /* slot of the key, or npos */
+    unsigned find(const std::u32string&) const;
+    unsigned find(const StringValue&) const;
+
+private:
+    explicit Shape(const std::vector<std::u32string>&);
+
+    std::vector<std::u32string> keys;
+};
+
+/*
+ * Keys and values of an object that does not share a Shape, in an
+ * open addressing hash table. The hash of each key is kept next to it, so
+ * probing compares strings only if the hashes match. Objects list their keys
+ * in order, so the keys are sorted once whenever they are listed after a key
+ * was added or removed.
+ */
+class Dictionary {
+public:
+    /* number of keys the table of a new dictionary has room for */
+    static const unsigned capacity = 8;
+
+    static std::size_t hash(const std::u32string&);
+
+    Dictionary();
+
+    unsigned long long size() const;
+
+    /* value of a key, nullptr if there is none */
+    Datum* find(const std::u32string&, const std::size_t& hash);
+    const Datum* find(const std::u32string&, const std::size_t& hash) const;
+    Datum* find(const StringValue&);
+    const Datum* find(const StringValue&) const;
+
+    void insert(const std::u32string&, const std::size_t& hash, const Datum&);
+    void erase(const std::u32string&, const std::size_t& hash);
+
+    /* key and value at a position in the order of the keys */
+    const std::u32string& keyAt(const unsigned long long&) const;
+    const Datum& valueAt(const unsigned long long&) const;
+
+private:
+    static const unsigned npos = static_cast<unsigned>(-1);
+
+    struct Entry {
+        std::u32string key;
+        std::size_t hash;
+        Datum value;
+    };
+
+    /* position in the table of a key, npos if there is none */
+    template<typename Key>
+    unsigned long long locate(const Key&, const std::size_t&) const;
+    void place(const unsigned&);
+    void sort() const;
+
+    std::vector<Entry> entries;
+
+    /* indices into entries, npos where free; the size is a power of two */
+    std::vector<unsigned> table;
+
+    /* indices into entries, sorted by key if "sorted" */
+    mutable std::vector<unsigned> order;
+    mutable bool sorted;
+};
+
+/*
+ * Remembers the slots a constant key was found at in objects of the last few
+ * shapes seen at one selector site. Sites seeing more shapes than that fall
+ * back to looking up the key.
+ */
+struct InlineCache {
+    static const unsigned size = 4;
+
+    explicit InlineCache(const std::shared_ptr<StringValue>& key);
+
+    std::shared_ptr<StringValue> key;
+    const Shape* shapes[size];
+    unsigned slots[size];
+    unsigned count;
+};
+
+/*
+ * Steps through the keys and values of a value, see Value::iterate. The
+ * position is an index, so a cursor sees the changes made to a value while
+ * iterating it the same way getKey and getValue do.
+ */
+class Cursor {
+public:
+    virtual ~Cursor();
+
+    /* moves to the next element, returns false if there is none */
+    virtual bool next() = 0;
+    virtual Datum getKey() = 0;
+    virtual Datum getValue() = 0;
+};
+
 struct Value {
+    const Type type;
+
+    explicit Value(const Type&);
     virtual ~Value();
 
-    virtual std::shared_ptr<Value> walk(ValueWalker&) = 0;
+    virtual Datum walk(ValueWalker&) = 0;
     virtual bool isTrue();
 
-    virtual std::shared_ptr<Value> doSelect(std::shared_ptr<Value>);
-    virtual std::shared_ptr<Value> doUnary(const UnaryOperator&);
-    virtual std::shared_ptr<Value> doBinary(const BinaryOperator&, std::shared_ptr<Value>);
-    virtual std::shared_ptr<Value> doCall(Program&, std::vector<std::shared_ptr<Value>>&);
-    virtual void doModify(std::shared_ptr<Value> index, std::shared_ptr<Value> value);
+    virtual Datum doSelect(const Datum&);
+    virtual Datum doSelect(InlineCache&);
+    virtual Datum doCall(Program&, std::vector<Datum>&);
+    virtual void doModify(const Datum& index, const Datum& value);
+    virtual void doModify(InlineCache&, const Datum& value);
     virtual unsigned long long getLength();
-    virtual std::shared_ptr<Value> getKey(const unsigned long long&);
-    virtual std::shared_ptr<Value> getValue(const unsigned long long&);
+    virtual Datum getKey(const unsigned long long&);
+    virtual Datum getValue(const unsigned long long&);
+
+    /* a cursor before the first element, stepping by getKey and getValue unless overridden */
+    virtual std::unique_ptr<Cursor> iterate();
 };
 
+/*
+ * The elements of an array are a range of a storage that slices of the array
+ * share. An array makes the storage its own before it is modified, so no
+ * other array ever sees the change.
+ */
 struct ArrayValue : public Value {
-    std::vector<std::shared_ptr<Value>> values;
-
     ArrayValue();
-    ArrayValue(const std::vector<std::shared_ptr<Value>>&);
-    std::shared_ptr<Value> walk(ValueWalker&);
-    virtual std::shared_ptr<Value> doSelect(std::shared_ptr<Value>);
-    virtual std::shared_ptr<Value> doBinary(const BinaryOperator&, std::shared_ptr<Value>);
-    virtual void doModify(std::shared_ptr<Value> index, std::shared_ptr<Value> value);
+    ArrayValue(std::vector<Datum>);
+    Datum walk(ValueWalker&);
+
+    /* adds an element in place, for arrays nothing else refers to; returns false if not supported */
+    virtual bool doAppend(const Datum&);
+    virtual Datum doSelect(const Datum&);
+    virtual void doModify(const Datum& index, const Datum& value);
     virtual unsigned long long getLength();
-    virtual std::shared_ptr<Value> getKey(const unsigned long long&);
-    virtual std::shared_ptr<Value> getValue(const unsigned long long&);
+    virtual Datum getKey(const unsigned long long&);
+    virtual Datum getValue(const unsigned long long&);
+    virtual std::unique_ptr<Cursor> iterate();
+
+    /* the elements from index "from" (including) to "to" (excluding), both within the length */
+    virtual std::shared_ptr<ArrayValue> slice(const unsigned long long& from, const unsigned long long& to);
+
+    /* the elements, valid until the array is modified */
+    const Datum* begin() const;
+    const Datum* end() const;
+
+private:
+    /* copy the elements if the storage is shared, or drop a large unused front */
+    void own();
+
+    std::shared_ptr<std::vector<Datum>> storage;
+    unsigned long long from;
+    unsigned long long to;
+};
+
+/*
+ * The integers from "first" on, "step" apart, as created by range(). The
+ * numbers are computed from their index rather than stored, and for loops
+ * count through them without a cursor.
+ */
+struct RangeValue : public ArrayValue {
+    const signed long long first;
+    const signed long long step;
+    const unsigned long long count;
+
+    RangeValue(const signed long long& first, const signed long long& step, const unsigned long long& count);
+
+    /* the numbers from "from" (including) up or down to "to" (excluding); the step must not be zero */
+    static std::shared_ptr<RangeValue> between(const signed long long& from, const signed long long& to, const signed long long& step);
+
+    signed long long at(const unsigned long long&) const;
+
+    bool doAppend(const Datum&);
+    Datum doSelect(const Datum&);
+    unsigned long long getLength();
+    Datum getKey(const unsigned long long&);
+    Datum getValue(const unsigned long long&);
+    std::unique_ptr<Cursor> iterate();
+    std::shared_ptr<ArrayValue> slice(const unsigned long long& from, const unsigned long long& to);
 };
 
 struct BoolValue : public Value {
+    static std::shared_ptr<BoolValue> trueSingleton;
+    static std::shared_ptr<BoolValue> falseSingleton;
+
     bool value;
 
     BoolValue(const bool& value);
-    std::shared_ptr<Value> walk(ValueWalker&);
+    Datum walk(ValueWalker&);
     bool isTrue();
-    std::shared_ptr<Value> doUnary(const UnaryOperator&);
-    std::shared_ptr<Value> doBinary(const BinaryOperator&, std::shared_ptr<Value>);
 };
 
 struct FloatValue : public Value {
     double value;
 
     FloatValue(const double& value);
-    std::shared_ptr<Value> walk(ValueWalker&);
-    std::shared_ptr<Value> doUnary(const UnaryOperator&);
-    std::shared_ptr<Value> doBinary(const BinaryOperator&, std::shared_ptr<Value>);
+    Datum walk(ValueWalker&);
 };
 
 struct FunctionValue : public Value {
-    std::vector<std::u32string> parameters;
+    std::vector<Atom> parameters;
     std::vector<std::shared_ptr<Statement>> statements;
+    std::shared_ptr<Layout> layout;
+
+    /* bytecode of the body, if created by the register machine or once the function got hot */
+    std::shared_ptr<Chunk> chunk;
+
+    /* calls so far, counted by the tree walker while there is no bytecode */
+    unsigned calls;
 
     FunctionValue();
-    FunctionValue(const std::vector<std::u32string>&, const std::vector<std::shared_ptr<Statement>>&);
-    std::shared_ptr<Value> walk(ValueWalker&);
-    virtual std::shared_ptr<Value> doBinary(const BinaryOperator&, std::shared_ptr<Value>);
-    virtual std::shared_ptr<Value> doCall(Program&, std::vector<std::shared_ptr<Value>>&);
+    FunctionValue(const std::vector<Atom>&, const std::vector<std::shared_ptr<Statement>>&);
+    Datum walk(ValueWalker&);
+    virtual Datum doCall(Program&, std::vector<Datum>&);
+
+    /* runs the body once in a scope prepared by doCall */
+    Datum run(Program&);
 };
 
 struct IntValue : public Value {
+    /* shares the instances of small integers */
+    static std::shared_ptr<IntValue> create(const signed long long&);
+
     signed long long value;
 
     IntValue(const signed long long& value);
-    std::shared_ptr<Value> walk(ValueWalker&);
-    std::shared_ptr<Value> doUnary(const UnaryOperator&);
-    std::shared_ptr<Value> doBinary(const BinaryOperator&, std::shared_ptr<Value>);
+    Datum walk(ValueWalker&);
 };
 
 struct NullValue : public Value {
     static std::shared_ptr<NullValue> singleton;
 
-    std::shared_ptr<Value> walk(ValueWalker&);
-    std::shared_ptr<Value> doBinary(const BinaryOperator&, std::shared_ptr<Value>);
+    NullValue();
+    Datum walk(ValueWalker&);
 };
 
+/*
+ * Objects created by a literal share a Shape and keep their values in slots
+ * in the order of the keys. As soon as a key is added or removed, an object
+ * moves its keys to a Dictionary of its own for good and has no shape from
+ * then on.
+ */
 struct ObjectValue : public Value {
-    std::map<std::u32string, std::shared_ptr<Value>> values;
+    const Shape* shape;
+    std::vector<Datum> slots;
+    Dictionary dictionary;
 
     ObjectValue();
-    ObjectValue(const std::map<std::u32string, std::shared_ptr<Value>>&);
-    std::shared_ptr<Value> walk(ValueWalker&);
-    virtual std::shared_ptr<Value> doSelect(std::shared_ptr<Value>);
-    virtual std::shared_ptr<Value> doBinary(const BinaryOperator&, std::shared_ptr<Value>);
-    virtual void doModify(std::shared_ptr<Value> index, std::shared_ptr<Value> value);
+    ObjectValue(const std::map<std::u32string, Datum>&);
+    ObjectValue(const Shape*, std::vector<Datum>&&);
+
+    /* value of a key, an empty Datum if there is none */
+    Datum find(const std::u32string&) const;
+    Datum find(const StringValue&) const;
+    void insert(const std::u32string&, const Datum&);
+    void insert(const StringValue&, const Datum&);
+    void erase(const std::u32string&);
+
+    /* key and value at a position in the order of the keys */
+    const std::u32string& keyAt(const unsigned long long&) const;
+    const Datum& valueAt(const unsigned long long&) const;
+
+    Datum walk(ValueWalker&);
+    virtual Datum doSelect(const Datum&);
+    virtual Datum doSelect(InlineCache&);
+    virtual void doModify(const Datum& index, const Datum& value);
+    virtual void doModify(InlineCache&, const Datum& value);
     virtual unsigned long long getLength();
-    virtual std::shared_ptr<Value> getKey(const unsigned long long&);
-    virtual std::shared_ptr<Value> getValue(const unsigned long long&);
+    virtual Datum getKey(const unsigned long long&);
+    virtual Datum getValue(const unsigned long long&);
+    virtual std::unique_ptr<Cursor> iterate();
+
+private:
+    /* moves the keys and values from the slots to the dictionary */
+    void unshape();
 };
 
+/*
+ * The characters of a string take one, two or four bytes each, whichever the
+ * widest of them needs, so most strings need a quarter of the memory UTF-32
+ * would and indexing stays constant time. Strings are never modified once
+ * created.
+ */
 struct StringValue : public Value {
     static std::string UTF32toUTF8(const std::u32string&);
     static std::u32string UTF8toUTF32(const std::string&);
 
-    std::u32string value;
+    /* shares the instances of single character strings */
+    static std::shared_ptr<StringValue> create(const char32_t&);
+
+    /* concatenations shorter than this are copied right away */
+    static const unsigned long long threshold = 256;
 
     StringValue();
     StringValue(const std::u32string& value);
-    std::shared_ptr<Value> walk(ValueWalker&);
-    std::shared_ptr<Value> doSelect(std::shared_ptr<Value>);
-    std::shared_ptr<Value> doBinary(const BinaryOperator&, std::shared_ptr<Value>);
+
+    /* the concatenation of two strings, which refers to both until the characters are needed */
+    StringValue(std::shared_ptr<StringValue>, std::shared_ptr<StringValue>);
+    ~StringValue();
+
+    unsigned long long size() const;
+    char32_t at(const unsigned long long&) const;
+    std::u32string toUTF32() const;
+
+    /* ASCII strings are returned as they are */
+    std::string toUTF8() const;
+
+    /* the characters as they are stored if they are ASCII, i.e. UTF-8 already; nullptr otherwise */
+    const std::string* getASCII() const;
+
+    /* less than, equal to or greater than zero, as for std::u32string::compare */
+    int compare(const std::u32string&) const;
+    bool equals(const StringValue&) const;
+
+    /* Dictionary::hash of the characters, computed once */
+    std::size_t getHash() const;
+
+    Datum walk(ValueWalker&);
+    Datum doSelect(const Datum&);
     unsigned long long getLength();
-    std::shared_ptr<Value> getKey(const unsigned long long&);
-    std::shared_ptr<Value> getValue(const unsigned long long&);
+    Datum getKey(const unsigned long long&);
+    Datum getValue(const unsigned long long&);
+    std::unique_ptr<Cursor> iterate();
+
+private:
+    /* copies the characters of a concatenation into the storage */
+    void flatten() const;
+    void append(const StringValue&) const;
+
+    /* the characters, "width" bytes each */
+    mutable std::string storage;
+    unsigned long long length;
+    unsigned char width;
+    bool ascii;
+
+    /* the parts of a concatenation that was not flattened yet */
+    mutable std::shared_ptr<StringValue> lhs;
+    mutable std::shared_ptr<StringValue> rhs;
+
+    mutable std::size_t hash;
 };
 
 class ValueWalker {
 public:
     virtual ~ValueWalker() = 0;
 
-    virtual std::shared_ptr<Value> value(ArrayValue& node) = 0;
-    virtual std::shared_ptr<Value> value(BoolValue& node) = 0;
-    virtual std::shared_ptr<Value> value(FloatValue& node) = 0;
-    virtual std::shared_ptr<Value> value(FunctionValue& node) = 0;
-    virtual std::shared_ptr<Value> value(IntValue& node) = 0;
-    virtual std::shared_ptr<Value> value(NullValue& node) = 0;
-    virtual std::shared_ptr<Value> value(ObjectValue& node) = 0;
-    virtual std::shared_ptr<Value> value(StringValue& node) = 0;
+    virtual Datum value(ArrayValue& node) = 0;
+    virtual Datum value(BoolValue& node) = 0;
+    virtual Datum value(FloatValue& node) = 0;
+    virtual Datum value(FunctionValue& node) = 0;
+    virtual Datum value(IntValue& node) = 0;
+    virtual Datum value(NullValue& node) = 0;
+    virtual Datum value(ObjectValue& node) = 0;
+    virtual Datum value(StringValue& node) = 0;
 };
 
 class DefaultValueWalker : public ValueWalker {
 public:
     virtual ~DefaultValueWalker() = 0;
 
-    virtual std::shared_ptr<Value> value(ArrayValue& node);
-    virtual std::shared_ptr<Value> value(BoolValue& node);
-    virtual std::shared_ptr<Value> value(FloatValue& node);
-    virtual std::shared_ptr<Value> value(FunctionValue& node);
-    virtual std::shared_ptr<Value> value(IntValue& node);
-    virtual std::shared_ptr<Value> value(NullValue& node);
-    virtual std::shared_ptr<Value> value(ObjectValue& node);
-    virtual std::shared_ptr<Value> value(StringValue& node);
+    virtual Datum value(ArrayValue& node);
+    virtual Datum value(BoolValue& node);
+    virtual Datum value(FloatValue& node);
+    virtual Datum value(FunctionValue& node);
+    virtual Datum value(IntValue& node);
+    virtual Datum value(NullValue& node);
+    virtual Datum value(ObjectValue& node);
+    virtual Datum value(StringValue& node);
 };
 
+/* the accessors and scalar operations are used on every evaluation */
+
+inline Datum::Datum(const bool& value) : tag(Tag::BOOL), boolean(value) {
+}
+
+inline Datum::Datum(const signed long long& value) : tag(Tag::INT), integer(value) {
+}
+
+inline Datum::Datum(const double& value) : tag(Tag::FLOAT), real(value) {
+}
+
+inline Datum::~Datum() {
+    if (tag == Tag::BOXED) {
+        boxed.~shared_ptr<Value>();
+    }
+}
+
+inline Datum::Tag Datum::getTag() const {
+    return tag;
+}
+
+inline Type Datum::getType() const {
+    switch (tag) {
+    case Tag::BOOL:
+        return Type::BOOL;
+    case Tag::INT:
+        return Type::INT;
+    case Tag::FLOAT:
+        return Type::FLOAT;
+    case Tag::BOXED:
+        return boxed->type;
+    default:
+        return Type::NUL;
+    }
+}
+
+inline bool Datum::isEmpty() const {
+    return tag == Tag::EMPTY;
+}
+
+inline bool Datum::getBool() const {
+    return boolean;
+}
+
+inline signed long long Datum::getInt() const {
+    return integer;
+}
+
+inline double Datum::getFloat() const {
+    return real;
+}
+
+inline const std::shared_ptr<Value>& Datum::getBoxed() const {
+    return boxed;
+}
+
+inline Datum Datum::unaryBool(const UnaryOperator& oper, const bool& rhs) {
+    if (oper == UnaryOperator::NOT) {
+        return Datum(!rhs);
+    }
+    return NullValue::singleton;
+}
+
+inline Datum Datum::unaryInt(const UnaryOperator& oper, const signed long long& rhs) {
+    if (oper == UnaryOperator::NEG) {
+        return Datum(-rhs);
+    }
+    return NullValue::singleton;
+}
+
+inline Datum Datum::unaryFloat(const UnaryOperator& oper, const double& rhs) {
+    if (oper == UnaryOperator::NEG) {
+        return Datum(-rhs);
+    }
+    return NullValue::singleton;
+}
+
+inline Datum Datum::binaryBool(const BinaryOperator& oper, const bool& lhs, const bool& rhs) {
+    switch (oper) {
+    case BinaryOperator::AND:
+        return Datum(lhs && rhs);
+    case BinaryOperator::OR:
+        return Datum(lhs || rhs);
+    case BinaryOperator::EQU:
+        return Datum(lhs == rhs);
+    case BinaryOperator::NEQ:
+        return Datum(lhs != rhs);
+    default:
+        break;
+    }
+    return NullValue::singleton;
+}
+
+inline Datum Datum::binaryInt(const BinaryOperator& oper, const signed long long& lhs, const signed long long& rhs) {
+    switch (oper) {
+    case BinaryOperator::ADD:
+        return Datum(lhs + rhs);
+    case BinaryOperator::SUB:
+        return Datum(lhs - rhs);
+    case BinaryOperator::MUL:
+        return Datum(lhs * rhs);
+    case BinaryOperator::DIV:
+        if (rhs != 0) {
+            return Datum(lhs / rhs);
+        }
+        break;
+    case BinaryOperator::MOD:
+        if (rhs != 0) {
+            return Datum(lhs % rhs);
+        }
+        break;
+    case BinaryOperator::EQU:
+        return Datum(lhs == rhs);
+    case BinaryOperator::NEQ:
+        return Datum(lhs != rhs);
+    case BinaryOperator::LES:
+        return Datum(lhs < rhs);
+    case BinaryOperator::LEQ:
+        return Datum(lhs <= rhs);
+    case BinaryOperator::GRT:
+        return Datum(lhs > rhs);
+    case BinaryOperator::GEQ:
+        return Datum(lhs >= rhs);
+    default:
+        break;
+    }
+    return NullValue::singleton;
+}
+
+inline Datum Datum::binaryFloat(const BinaryOperator& oper, const double& lhs, const double& rhs, const bool& mixed) {
+    switch (oper) {
+    case BinaryOperator::ADD:
+        return Datum(lhs + rhs);
+    case BinaryOperator::SUB:
+        return Datum(lhs - rhs);
+    case BinaryOperator::MUL:
+        return Datum(lhs * rhs);
+    case BinaryOperator::DIV:
+        if (rhs != 0.0) {
+            return Datum(lhs / rhs);
+        }
+        break;
+    case BinaryOperator::EQU:
+        if (!mixed) {
+            return Datum(lhs == rhs);
+        }
+        break;
+    case BinaryOperator::NEQ:
+        if (!mixed) {
+            return Datum(lhs != rhs);
+        }
+        break;
+    case BinaryOperator::LES:
+        return Datum(lhs < rhs);
+    case BinaryOperator::LEQ:
+        return Datum(lhs <= rhs);
+    case BinaryOperator::GRT:
+        return Datum(lhs > rhs);
+    case BinaryOperator::GEQ:
+        return Datum(lhs >= rhs);
+    default:
+        break;
+    }
+    return NullValue::singleton;
+}
+
 } /* namespace noumenon */
 
 #endif /* VALUE_H_ */